@@ -0,0 +1,152 @@
+// Цена стадий анализа чанка по отдельности и вместе: специализированные проходы AnalysisPipeline против
+// прежнего прохода с проверкой маски на каждом слове и против отдельного прохода на каждую стадию.
+//
+//   analysis_stages [corpus] [rounds] [chunk_size]
+#include "sentence_splitter.hpp"
+#include "words_util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+using namespace util;
+
+namespace {
+using Chunks = std::vector<std::vector<std::string_view>>;
+
+template <typename Body>
+void measure(const char *name, size_t bytes, size_t rounds, Body body)
+{
+    // Первый прогон не считается: прогрев кэшей и аллокатора
+    size_t checksum = body();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        checksum += body();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fmt::println("{:<36} {:>8.1f} MB/s  {:>8.2f} ms/round  (checksum {})", name,
+                 static_cast<double>(bytes * rounds) / seconds / 1e6, seconds * 1e3 / rounds, checksum);
+}
+
+size_t mix(const ChunkAnalysis &analysis)
+{
+    return analysis.word_count + analysis.word_frequencies.size() + analysis.positive * 31 + analysis.negative;
+}
+
+// Прежний analyzeChunk: один проход на все маски, ветвления по маске на каждом слове
+ChunkAnalysis branchyPass(std::span<const std::string_view> sentences, unsigned analyses)
+{
+    ChunkAnalysis result;
+    LowerArena arena;
+    for (auto sentence : sentences) {
+        arena.tokenize(sentence);
+        result.word_count += arena.words().size();
+        if ((analyses & (WORD_FREQUENCIES | SENTIMENT)) == 0) {
+            continue;
+        }
+        for (auto token : arena.words()) {
+            auto word = arena.word(token);
+            if (analyses & WORD_FREQUENCIES) {
+                result.word_frequencies.add(word);
+            }
+            if (analyses & SENTIMENT) {
+                SentimentStage::word(word, result);
+            }
+        }
+    }
+    return result;
+}
+
+template <typename Pass>
+size_t overChunks(const Chunks &chunks, Pass pass)
+{
+    size_t checksum = 0;
+    for (const auto &chunk : chunks) {
+        checksum += pass(std::span<const std::string_view>(chunk));
+    }
+    return checksum;
+}
+
+template <typename... Stages>
+size_t pipeline(std::span<const std::string_view> sentences)
+{
+    ChunkAnalysis result;
+    AnalysisPipeline<Stages...>::run(sentences, result);
+    return mix(result);
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "moby_dick.txt";
+    size_t rounds = argc > 2 ? std::stoull(argv[2]) : 10;
+    size_t chunk_size = argc > 3 ? std::stoull(argv[3]) : 50;
+
+    SentenceSplitter splitter;
+    splitter.readAndSplit(path);
+    const auto &sentences = splitter.getSentences();
+    Chunks chunks;
+    for (size_t i = 0; i < sentences.size(); i += chunk_size) {
+        auto &chunk = chunks.emplace_back();
+        for (size_t j = i; j < std::min(sentences.size(), i + chunk_size); ++j) {
+            chunk.push_back(sentences[j]);
+        }
+    }
+    size_t bytes = sentences.bytes();
+    fmt::println("{} sentences in {} chunks, {:.1f} MB", sentences.size(), chunks.size(), bytes / 1e6);
+
+    fmt::println("\nper stage:");
+    measure("words", bytes, rounds, [&] { return overChunks(chunks, pipeline<WordCountStage>); });
+    measure("frequencies", bytes, rounds, [&] { return overChunks(chunks, pipeline<WordFrequencyStage>); });
+    measure("sentiment", bytes, rounds, [&] { return overChunks(chunks, pipeline<SentimentStage>); });
+    NameRules rules;
+    measure("names", bytes, rounds, [&] {
+        return overChunks(chunks, [&](std::span<const std::string_view> chunk) {
+            SentenceStore replaced;
+            replaceNames(chunk, "ASSGRIM", rules, replaced);
+            return replaced.bytes();
+        });
+    });
+    measure("sort", bytes, rounds, [&] {
+        return overChunks(chunks, [](std::span<const std::string_view> chunk) {
+            return static_cast<size_t>(sortedIndicesByLength(chunk).front());
+        });
+    });
+
+    fmt::println("\nword stages combined:");
+    measure("fused words+frequencies+sentiment", bytes, rounds, [&] {
+        return overChunks(chunks, pipeline<WordCountStage, WordFrequencyStage, SentimentStage>);
+    });
+    measure("separate passes", bytes, rounds, [&] {
+        return overChunks(chunks, [](std::span<const std::string_view> chunk) {
+            return pipeline<WordCountStage>(chunk) + pipeline<WordFrequencyStage>(chunk) +
+                   pipeline<SentimentStage>(chunk);
+        });
+    });
+    measure("fused frequencies+sentiment", bytes, rounds,
+            [&] { return overChunks(chunks, pipeline<WordFrequencyStage, SentimentStage>); });
+
+    fmt::println("\nruntime mask (analyzeChunk) vs. branches on every word:");
+    for (unsigned mask : {unsigned(WORD_COUNT), unsigned(SENTIMENT), unsigned(WORD_ANALYSES)}) {
+        measure(fmt::format("analyzeChunk mask {:#x}", mask).c_str(), bytes, rounds, [&] {
+            return overChunks(chunks, [&](std::span<const std::string_view> chunk) {
+                return mix(analyzeChunk(chunk, mask));
+            });
+        });
+        measure(fmt::format("branchy pass mask {:#x}", mask).c_str(), bytes, rounds, [&] {
+            return overChunks(chunks, [&](std::span<const std::string_view> chunk) {
+                // Прежний проход считал слова при любой маске
+                auto result = branchyPass(chunk, mask);
+                if ((mask & WORD_COUNT) == 0) {
+                    result.word_count = 0;
+                }
+                return mix(result);
+            });
+        });
+    }
+    return 0;
+}
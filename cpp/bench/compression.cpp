@@ -0,0 +1,145 @@
+// Процессор против байтов в сети: сжатие тел задач и результатов кодеками PayloadCodec при разных размерах чанка.
+// Словарь zstd обучается на первой половине корпуса, меряется всё на второй, чтобы текст не попал в словарь.
+//
+//   compression [corpus] [rounds]
+#include "payload_codec.hpp"
+#include "sentence_splitter.hpp"
+#include "wire_format.hpp"
+#include "words_util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+using namespace util;
+
+namespace {
+struct Bodies {
+    std::vector<std::string> tasks;
+    std::vector<std::string> results;
+};
+
+// Тела задач и несжатых (не compact) результатов для чанков по chunk_size предложений из [first, last)
+Bodies makeBodies(const SentenceStore &all, size_t first, size_t last, size_t chunk_size)
+{
+    Bodies bodies;
+    NameRules rules;
+    for (size_t i = first; i < last; i += chunk_size) {
+        std::vector<std::string_view> sentences;
+        for (size_t j = i; j < std::min(last, i + chunk_size); ++j) {
+            sentences.push_back(all[j]);
+        }
+        wire::TaskMessage task{.chunk = i, .sentences = sentences};
+        bodies.tasks.push_back(wire::encode(task, wire::Format::Binary));
+
+        auto analysis = analyzeChunk(sentences, ALL_ANALYSES);
+        SentenceStore replaced;
+        replaceNames(sentences, "ASSGRIM", rules, replaced);
+        wire::ResultMessage result{.chunk = i, .word_count = analysis.word_count};
+        result.word_frequencies.assign(analysis.word_frequencies.begin(), analysis.word_frequencies.end());
+        result.sorted_sentences = sortSentencesByLength(sentences);
+        result.sentences_with_replaced_names = replaced.views();
+        bodies.results.push_back(wire::encode(result, wire::Format::Binary));
+    }
+    return bodies;
+}
+
+void measure(const char *kind, size_t chunk_size, const char *name, const PayloadCodec &codec,
+             const std::vector<std::string> &bodies, size_t rounds)
+{
+    size_t raw = 0;
+    size_t wire = 0;
+    std::vector<std::string> compressed(bodies.size());
+    std::vector<std::string_view> encodings(bodies.size());
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            compressed[i] = bodies[i];
+            encodings[i] = codec.compress(compressed[i]);
+        }
+    }
+    double compress_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string buffer;
+    size_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            checksum += codec.decompress(compressed[i], encodings[i], buffer).size();
+        }
+    }
+    double decompress_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        raw += bodies[i].size();
+        wire += compressed[i].size();
+    }
+    if (checksum != raw * rounds) {
+        fmt::println("{} {} {}: roundtrip MISMATCH", kind, chunk_size, name);
+    }
+    if (codec.codec() == Codec::None) {
+        fmt::println("{:<7} {:>5} {:<12} {:>9} B/msg", kind, chunk_size, name, raw / bodies.size());
+        return;
+    }
+    // Копирование тела в compressed[i] входит во время сжатия
+    double megabytes = static_cast<double>(raw * rounds) / 1e6;
+    fmt::println("{:<7} {:>5} {:<12} {:>9} B/msg {:>6.1f}%  compress {:>8.1f} MB/s  decompress {:>8.1f} MB/s", kind,
+                 chunk_size, name, wire / bodies.size(), 100.0 * wire / raw, megabytes / compress_seconds,
+                 megabytes / decompress_seconds);
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "moby_dick.txt";
+    size_t rounds = argc > 2 ? std::stoull(argv[2]) : 5;
+
+    SentenceSplitter splitter;
+    splitter.readAndSplit(path);
+    const auto &all = splitter.getSentences();
+    size_t half = all.size() / 2;
+
+    auto dictionary_path = (std::filesystem::temp_directory_path() / "lab2_bench.zdict").string();
+    {
+        auto training = makeBodies(all, 0, half, 50);
+        auto &samples = training.tasks;
+        samples.insert(samples.end(), training.results.begin(), training.results.end());
+        auto dictionary = trainDictionary(samples, 112 << 10);
+        std::ofstream(dictionary_path, std::ios::binary).write(dictionary.data(), dictionary.size());
+        fmt::println("{} sentences; dictionary of {:.1f} KB trained on the first {}", all.size(),
+                     dictionary.size() / 1024.0, half);
+    }
+
+    struct Setup {
+        const char *name;
+        CompressionOptions options;
+    };
+    std::vector<Setup> setups = {
+        {"none", {.codec = Codec::None}},
+        {"lz4", {.codec = Codec::Lz4, .min_bytes = 0}},
+        {"zstd-1", {.codec = Codec::Zstd, .min_bytes = 0, .level = 1}},
+        {"zstd-3", {.codec = Codec::Zstd, .min_bytes = 0, .level = 3}},
+        {"zstd-1+dict", {.codec = Codec::Zstd, .min_bytes = 0, .level = 1, .dictionary = dictionary_path}},
+        {"zstd-3+dict", {.codec = Codec::Zstd, .min_bytes = 0, .level = 3, .dictionary = dictionary_path}},
+    };
+
+    for (size_t chunk_size : {10, 50, 200, 1000}) {
+        auto bodies = makeBodies(all, half, all.size(), chunk_size);
+        fmt::println("");
+        for (const auto &setup : setups) {
+            PayloadCodec codec(setup.options);
+            measure("task", chunk_size, setup.name, codec, bodies.tasks, rounds);
+        }
+        for (const auto &setup : setups) {
+            PayloadCodec codec(setup.options);
+            measure("result", chunk_size, setup.name, codec, bodies.results, rounds);
+        }
+    }
+    std::filesystem::remove(dictionary_path);
+    return 0;
+}
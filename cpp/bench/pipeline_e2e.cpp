@@ -0,0 +1,233 @@
+// Сквозной бенчмарк конвейера splitter -> worker -> aggregator через RabbitMQ (docker-compose.yaml).
+// Для каждого сочетания размера корпуса, числа воркеров, потоков воркера и размера чанка запускает
+// агрегатор с LAB2_EXIT_AFTER_JOBS=1, воркеры и сплиттер, затем читает отчёт агрегатора.
+// Очереди перед запуском должны быть пустыми.
+//
+//   pipeline_e2e [corpus]
+//   LAB2_BENCH_SIZES_MB=10,50  LAB2_BENCH_WORKERS=1,2,4  LAB2_BENCH_THREADS=1  LAB2_BENCH_CHUNKS=50
+//   Чанки по байтам: LAB2_CHUNK_BYTES или LAB2_CHUNK_TARGET_MS в окружении и LAB2_BENCH_CHUNKS=0
+//   LAB2_BIN_DIR - каталог с бинарниками (по умолчанию ../bins рядом с бенчмарком)
+//   LAB2_BENCH_OUT - куда записать результаты в JSON (по умолчанию pipeline_e2e.json)
+//   LAB2_BENCH_INPROC=1 - вместо брокера запускать бинарник pipeline (всё в одном процессе)
+#include "config.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+extern char **environ;
+
+namespace {
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+std::vector<size_t> envList(const char *name, const std::string &fallback)
+{
+    std::vector<size_t> values;
+    std::stringstream list(util::envString(name, fallback));
+    for (std::string item; std::getline(list, item, ',');) {
+        values.push_back(std::stoull(item));
+    }
+    return values;
+}
+
+// Корпус нужного размера - исходный текст, повторённый до target байт
+fs::path replicate(const fs::path &source, size_t megabytes)
+{
+    auto path = fs::temp_directory_path() / fmt::format("lab2-corpus-{}mb.txt", megabytes);
+    size_t target = megabytes << 20;
+    if (fs::exists(path) && fs::file_size(path) >= target) {
+        return path;
+    }
+
+    std::ifstream in(source, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (text.empty()) {
+        throw std::runtime_error("replicate: cannot read " + source.string());
+    }
+    std::ofstream out(path, std::ios::binary);
+    for (size_t written = 0; written < target; written += text.size() + 1) {
+        out << text << '\n';
+    }
+    return path;
+}
+
+// Запускает процесс с добавленными переменными окружения, вывод уходит в /dev/null
+pid_t spawn(const fs::path &binary, const std::vector<std::string> &args, const std::vector<std::string> &env)
+{
+    std::vector<std::string> environment = env;
+    for (char **entry = environ; *entry != nullptr; ++entry) {
+        environment.emplace_back(*entry);
+    }
+    std::vector<char *> envp;
+    for (auto &entry : environment) {
+        envp.push_back(entry.data());
+    }
+    envp.push_back(nullptr);
+
+    std::string program = binary.string();
+    std::vector<std::string> argument_storage = args;
+    std::vector<char *> argv{program.data()};
+    for (auto &argument : argument_storage) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    pid_t pid = 0;
+    int error = posix_spawn(&pid, program.c_str(), &actions, nullptr, argv.data(), envp.data());
+    posix_spawn_file_actions_destroy(&actions);
+    if (error != 0) {
+        throw std::runtime_error("spawn: cannot start " + program);
+    }
+    return pid;
+}
+
+int wait(pid_t pid)
+{
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+struct Run {
+    size_t megabytes;
+    size_t workers;
+    size_t threads;
+    size_t chunk_size;
+};
+
+json runInProcess(const fs::path &bin_dir, const fs::path &corpus, const Run &run, const fs::path &report_path)
+{
+    int status = wait(spawn(bin_dir / "pipeline", {corpus.string()},
+                            {"LAB2_PIPELINE_WORKERS=" + std::to_string(run.workers),
+                             "LAB2_WORKER_THREADS=" + std::to_string(run.threads),
+                             "LAB2_CHUNK_SIZE=" + std::to_string(run.chunk_size), "LAB2_SINK=none",
+                             "LAB2_PROGRESS_S=0", "LAB2_REPORT=" + report_path.string()}));
+    if (status != 0) {
+        throw std::runtime_error(fmt::format("runInProcess: pipeline exited with {}", status));
+    }
+    std::ifstream in(report_path);
+    return json::parse(in);
+}
+
+json runBrokered(const fs::path &bin_dir, const fs::path &corpus, const Run &run, const fs::path &report_path)
+{
+    // Отчёты о прогрессе в бенчмарке не нужны, их таймер лишь будил бы цикл агрегатора
+    pid_t aggregator = spawn(bin_dir / "aggregator", {},
+                             {"LAB2_EXIT_AFTER_JOBS=1", "LAB2_SINK=none", "LAB2_PROGRESS_S=0",
+                              "LAB2_REPORT=" + report_path.string()});
+    std::vector<pid_t> workers;
+    for (size_t i = 0; i < run.workers; ++i) {
+        workers.push_back(spawn(bin_dir / "worker", {}, {"LAB2_WORKER_THREADS=" + std::to_string(run.threads)}));
+    }
+    // Даём потребителям подписаться на очереди
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    int splitter_status =
+        wait(spawn(bin_dir / "splitter", {corpus.string()}, {"LAB2_CHUNK_SIZE=" + std::to_string(run.chunk_size)}));
+    int aggregator_status = wait(aggregator);
+
+    for (pid_t worker : workers) {
+        kill(worker, SIGTERM);
+        wait(worker);
+    }
+    if (splitter_status != 0 || aggregator_status != 0) {
+        throw std::runtime_error(fmt::format("runOnce: splitter exited with {}, aggregator with {}", splitter_status,
+                                             aggregator_status));
+    }
+
+    std::ifstream in(report_path);
+    return json::parse(in);
+}
+
+json runOnce(const fs::path &bin_dir, const fs::path &corpus, const Run &run, bool in_process)
+{
+    auto report_path = fs::temp_directory_path() / "lab2-e2e-report.json";
+    fs::remove(report_path);
+
+    auto started = std::chrono::steady_clock::now();
+    json report = in_process ? runInProcess(bin_dir, corpus, run, report_path)
+                             : runBrokered(bin_dir, corpus, run, report_path);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    const auto &job = report.at("jobs").at(0);
+    // Длительность задачи считается агрегатором от момента старта сплиттера (id задачи)
+    double seconds = std::max(job.at("duration_ms").get<double>(), 1.0) / 1000.0;
+    double megabytes = fs::file_size(corpus) / 1e6;
+
+    return {{"size_mb", run.megabytes},
+            {"workers", run.workers},
+            {"threads", run.threads},
+            {"chunk_size", run.chunk_size},
+            {"seconds", seconds},
+            {"wall_seconds", wall},
+            {"mb_per_s", megabytes / seconds},
+            {"sentences_per_s", job.at("sentences").get<double>() / seconds},
+            {"latency_us", report.at("latency_us")}};
+}
+}
+
+int main(int argc, char **argv)
+{
+    fs::path source = argc > 1 ? argv[1] : "moby_dick.txt";
+    fs::path bin_dir = util::envString("LAB2_BIN_DIR", (fs::absolute(argv[0]).parent_path() / ".." / "bins").string());
+    auto sizes = envList("LAB2_BENCH_SIZES_MB", "10");
+    auto worker_counts = envList("LAB2_BENCH_WORKERS", "1,2,4");
+    auto thread_counts = envList("LAB2_BENCH_THREADS", "1");
+    auto chunk_sizes = envList("LAB2_BENCH_CHUNKS", "50");
+    auto out_path = util::envString("LAB2_BENCH_OUT", "pipeline_e2e.json");
+    bool in_process = util::envSize("LAB2_BENCH_INPROC", 0) != 0;
+
+    json runs = json::array();
+    fmt::println("{:>8} {:>8} {:>8} {:>8} {:>10} {:>14} {:>10} {:>12}", "MB", "workers", "threads", "chunk", "MB/s",
+                 "sentences/s", "p99 e2e", "efficiency");
+    for (size_t size : sizes) {
+        auto corpus = replicate(source, size);
+        for (size_t chunk_size : chunk_sizes) {
+            // Эффективность масштабирования - относительно первого (наименьшего) числа потоков в серии
+            double base_rate = 0;
+            size_t base_parallelism = 0;
+            for (size_t workers : worker_counts) {
+                for (size_t threads : thread_counts) {
+                    auto result = runOnce(bin_dir, corpus, {size, workers, threads, chunk_size}, in_process);
+                    double rate = result["mb_per_s"].get<double>();
+                    size_t parallelism = workers * threads;
+                    if (base_parallelism == 0) {
+                        base_rate = rate;
+                        base_parallelism = parallelism;
+                    }
+                    double efficiency =
+                        (rate / base_rate) / (static_cast<double>(parallelism) / static_cast<double>(base_parallelism));
+                    result["efficiency"] = efficiency;
+
+                    fmt::println("{:>8} {:>8} {:>8} {:>8} {:>10.1f} {:>14.0f} {:>8}us {:>12.2f}", size, workers,
+                                 threads, chunk_size, rate, result["sentences_per_s"].get<double>(),
+                                 result["latency_us"]["end_to_end"]["p99"].get<uint64_t>(), efficiency);
+                    runs.push_back(std::move(result));
+                }
+            }
+        }
+    }
+
+    std::ofstream out(out_path);
+    out << json{{"corpus", source.string()}, {"transport", in_process ? "inproc" : "amqp"}, {"runs", runs}}.dump(2)
+        << '\n';
+    fmt::println("Results written to {}", out_path);
+    return 0;
+}
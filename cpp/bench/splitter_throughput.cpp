@@ -0,0 +1,46 @@
+#include "sentence_splitter.hpp"
+
+#include <chrono>
+#include <thread>
+
+#include <fmt/format.h>
+
+using namespace util;
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "moby_dick.txt";
+    size_t copies = argc > 2 ? std::stoull(argv[2]) : 20;
+    size_t max_threads = argc > 3 ? std::stoull(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+
+    MappedFile file(path);
+    std::string text;
+    text.reserve(file.view().size() * copies);
+    for (size_t i = 0; i < copies; ++i) {
+        text.append(file.view());
+        text.push_back('\n');
+    }
+    double megabytes = text.size() / 1e6;
+    fmt::println("corpus: {} x {} = {:.1f} MB", path, copies, megabytes);
+
+    SentenceSplitter serial;
+    auto start = std::chrono::steady_clock::now();
+    serial.splitSentences(text);
+    double base = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fmt::println("{:>8} {:>10.1f} MB/s  {} sentences", "serial", megabytes / base, serial.getSentences().size());
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        SentenceSplitter parallel;
+        start = std::chrono::steady_clock::now();
+        parallel.splitSentencesParallel(text, threads);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        bool same = parallel.getSentences() == serial.getSentences();
+        fmt::println("{:>8} {:>10.1f} MB/s  speedup {:.2f}x  {}", threads, megabytes / seconds, base / seconds,
+                     same ? "identical" : "MISMATCH");
+        if (!same) {
+            return 1;
+        }
+    }
+    return 0;
+}
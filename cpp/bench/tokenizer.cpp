@@ -0,0 +1,153 @@
+// Токенизатор и перевод в нижний регистр на всех доступных наборах инструкций против прежних реализаций:
+// std::istringstream >> word с ::tolower по байту и цикла по isspace с std::transform.
+//
+//   tokenizer [corpus] [rounds]
+#include "sentence_splitter.hpp"
+#include "tokenizer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+using namespace util;
+
+namespace {
+template <typename Body>
+void measure(const char *name, size_t bytes, size_t rounds, Body body)
+{
+    size_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        checksum += body();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fmt::println("{:<28} {:>8.2f} GB/s  (checksum {})", name, static_cast<double>(bytes * rounds) / seconds / 1e9,
+                 checksum);
+}
+
+// Контрольная сумма слов: длина и первый байт каждого, чтобы компилятор не выбросил работу
+size_t mix(std::string_view word)
+{
+    return word.size() * 31 + static_cast<unsigned char>(word.front());
+}
+
+size_t streamBaseline(const SentenceStore &sentences)
+{
+    size_t checksum = 0;
+    for (auto sentence : sentences) {
+        std::istringstream stream{std::string(sentence)};
+        std::string word;
+        while (stream >> word) {
+            if (word.back() == '.') {
+                word.pop_back();
+            }
+            if (word.empty()) {
+                continue;
+            }
+            std::transform(word.begin(), word.end(), word.begin(), ::tolower);
+            checksum += mix(word);
+        }
+    }
+    return checksum;
+}
+
+size_t loopBaseline(const SentenceStore &sentences)
+{
+    auto is_space = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    size_t checksum = 0;
+    std::string lower;
+    for (std::string_view text : sentences) {
+        size_t i = 0;
+        while (i < text.size()) {
+            while (i < text.size() && is_space(text[i])) {
+                ++i;
+            }
+            size_t start = i;
+            while (i < text.size() && !is_space(text[i])) {
+                ++i;
+            }
+            auto word = text.substr(start, i - start);
+            if (!word.empty() && word.back() == '.') {
+                word.remove_suffix(1);
+            }
+            if (!word.empty()) {
+                lower.assign(word);
+                std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+                checksum += mix(lower);
+            }
+        }
+    }
+    return checksum;
+}
+
+bool checkCyrillic(SimdLevel level)
+{
+    // Достаточно длинная строка, чтобы пары байтов попадали и внутрь блоков, и на их границы
+    std::string text = "Ёлка и ЯБЛОКО, ПРИВЕТ Мир! Ѐ Џ Abc.  ";
+    std::string expected = "ёлка и яблоко, привет мир! ѐ џ abc.  ";
+    for (int i = 0; i < 4; ++i) {
+        text = " " + text + text;
+        expected = " " + expected + expected;
+    }
+    std::string lower(text.size(), '\0');
+    std::vector<Token> tokens;
+    tokenizeLower(text, lower.data(), tokens, level);
+    return lower == expected;
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "moby_dick.txt";
+    size_t rounds = argc > 2 ? std::stoull(argv[2]) : 10;
+
+    SentenceSplitter splitter;
+    splitter.readAndSplit(path);
+    const auto &sentences = splitter.getSentences();
+    size_t bytes = sentences.bytes();
+    fmt::println("{} sentences, {:.1f} MB, best SIMD level: {}", sentences.size(), bytes / 1e6,
+                 simdName(supportedSimdLevel()));
+
+    measure("istringstream + tolower", bytes, rounds, [&] { return streamBaseline(sentences); });
+    measure("isspace loop + tolower", bytes, rounds, [&] { return loopBaseline(sentences); });
+
+    std::vector<Token> tokens;
+    std::string lower;
+    for (auto level : {SimdLevel::Scalar, SimdLevel::Sse42, SimdLevel::Avx2}) {
+        if (level > supportedSimdLevel()) {
+            continue;
+        }
+        if (!checkCyrillic(level)) {
+            fmt::println("{}: Cyrillic lowercase MISMATCH", simdName(level));
+        }
+        measure(fmt::format("tokenize {}", simdName(level)).c_str(), bytes, rounds, [&] {
+            size_t checksum = 0;
+            for (std::string_view sentence : sentences) {
+                tokens.clear();
+                tokenize(sentence, tokens, level);
+                for (auto token : tokens) {
+                    checksum += mix(sentence.substr(token.offset, token.length));
+                }
+            }
+            return checksum;
+        });
+        measure(fmt::format("tokenize+lower {}", simdName(level)).c_str(), bytes, rounds, [&] {
+            size_t checksum = 0;
+            for (std::string_view sentence : sentences) {
+                tokens.clear();
+                lower.resize(sentence.size());
+                tokenizeLower(sentence, lower.data(), tokens, level);
+                for (auto token : tokens) {
+                    checksum += mix(std::string_view(lower).substr(token.offset, token.length));
+                }
+            }
+            return checksum;
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "sentence_splitter.hpp"
+#include "wire_format.hpp"
+#include "words_util.hpp"
+
+#include <chrono>
+#include <vector>
+
+#include <fmt/format.h>
+
+using namespace util;
+
+namespace {
+struct Sample {
+    std::vector<std::string> sentences;
+    WordCounts word_frequencies;
+    std::vector<std::string> sorted;
+    std::vector<std::string> replaced;
+};
+
+wire::TaskMessage makeTask(const Sample &sample, uint64_t chunk)
+{
+    return {.id = 1, .chunk = chunk, .total = 0, .sentences = wire::toViews(sample.sentences)};
+}
+
+wire::ResultMessage makeResult(const Sample &sample, uint64_t chunk)
+{
+    wire::ResultMessage result{.id = 1, .chunk = chunk, .total = 0, .word_count = 42};
+    result.word_frequencies.assign(sample.word_frequencies.begin(), sample.word_frequencies.end());
+    result.positive = 3;
+    result.negative = 5;
+    result.score = -2;
+    result.sorted_sentences = wire::toViews(sample.sorted);
+    result.sentences_with_replaced_names = wire::toViews(sample.replaced);
+    return result;
+}
+
+template <typename Make, typename Decode>
+void run(const char *name, const std::vector<Sample> &samples, size_t rounds, Make make, Decode decode)
+{
+    for (auto format : {wire::Format::Json, wire::Format::Binary}) {
+        size_t bytes = 0;
+        size_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        for (size_t round = 0; round < rounds; ++round) {
+            for (size_t i = 0; i < samples.size(); ++i) {
+                auto body = wire::encode(make(samples[i], i), format);
+                auto decoded = decode(body, format);
+                bytes += body.size();
+                checksum += decoded.chunk;
+            }
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t messages = rounds * samples.size();
+        fmt::println("{:<7} {:<7} {:>10.0f} ns/msg {:>8.1f} MB/s  {:>8} B/msg  (checksum {})", name,
+                     format == wire::Format::Json ? "json" : "binary", seconds * 1e9 / messages,
+                     bytes / seconds / 1e6, bytes / messages, checksum);
+    }
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "moby_dick.txt";
+    size_t chunk_size = argc > 2 ? std::stoull(argv[2]) : 50;
+    size_t rounds = argc > 3 ? std::stoull(argv[3]) : 5;
+
+    SentenceSplitter splitter;
+    splitter.readAndSplit(path);
+    const auto &all = splitter.getSentences();
+
+    std::vector<Sample> samples;
+    for (size_t i = 0; i < all.size(); i += chunk_size) {
+        Sample sample;
+        for (size_t j = i; j < std::min(all.size(), i + chunk_size); ++j) {
+            sample.sentences.emplace_back(all[j]);
+        }
+        sample.word_frequencies = countWords(sample.sentences);
+        sample.sorted = sortSentencesByLength(sample.sentences);
+        sample.replaced = replaceNames(sample.sentences, "ASSGRIM");
+        samples.push_back(std::move(sample));
+    }
+    fmt::println("{} sentences, {} chunks of {}, {} rounds", all.size(), samples.size(), chunk_size, rounds);
+
+    run("task", samples, rounds, makeTask, wire::decodeTask);
+    run("result", samples, rounds, makeResult, wire::decodeResult);
+    return 0;
+}
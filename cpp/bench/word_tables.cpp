@@ -0,0 +1,90 @@
+#include "sentence_splitter.hpp"
+#include "sentiment_lexicon.hpp"
+#include "word_counter.hpp"
+#include "words_util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include <fmt/format.h>
+
+using namespace util;
+
+namespace {
+template <typename Body>
+void measure(const char *name, size_t operations, size_t rounds, Body body)
+{
+    size_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        checksum += body();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fmt::println("{:<28} {:>8.1f} ns/op  (checksum {})", name, seconds * 1e9 / (operations * rounds), checksum);
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "moby_dick.txt";
+    size_t rounds = argc > 2 ? std::stoull(argv[2]) : 10;
+
+    SentenceSplitter splitter;
+    splitter.readAndSplit(path);
+
+    std::vector<std::string> words;
+    for (const auto &sentence : splitter.getSentences()) {
+        for (auto &word : splitIntoWords(sentence)) {
+            std::ranges::transform(word, word.begin(), ::tolower);
+            words.push_back(std::move(word));
+        }
+    }
+    fmt::println("{} words, {} rounds", words.size(), rounds);
+
+    fmt::println("\ncounting:");
+    measure("std::map<std::string>", words.size(), rounds, [&] {
+        std::map<std::string, size_t> counts;
+        for (const auto &word : words) {
+            counts[word]++;
+        }
+        return counts.size();
+    });
+    measure("std::unordered_map", words.size(), rounds, [&] {
+        std::unordered_map<std::string, size_t> counts;
+        for (const auto &word : words) {
+            counts[word]++;
+        }
+        return counts.size();
+    });
+    measure("WordCounter", words.size(), rounds, [&] {
+        WordCounter counts;
+        for (const auto &word : words) {
+            counts.add(word);
+        }
+        return counts.size();
+    });
+
+    fmt::println("\nsentiment lookup:");
+    std::set<std::string> positive, negative;
+    for (const auto &entry : lexicon::SENTIMENT_WORDS) {
+        (entry.polarity > 0 ? positive : negative).emplace(entry.word);
+    }
+    measure("std::set x2", words.size(), rounds, [&] {
+        size_t hits = 0;
+        for (const auto &word : words) {
+            hits += positive.contains(word) || negative.contains(word);
+        }
+        return hits;
+    });
+    measure("constexpr perfect hash", words.size(), rounds, [&] {
+        size_t hits = 0;
+        for (const auto &word : words) {
+            hits += lexicon::SENTIMENT.polarity(word) != 0;
+        }
+        return hits;
+    });
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "inproc_transport.hpp"
+#include "stages.hpp"
+#include "config.hpp"
+#include "metrics.hpp"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+// Весь конвейер в одном процессе: сплиттер, воркеры и агрегатор в своих потоках обмениваются
+// сообщениями через InProcBroker вместо RabbitMQ. Удобно для профилирования и запусков на одной машине.
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "moby_dick.txt";
+    size_t worker_count = std::max<size_t>(1, util::envSize("LAB2_PIPELINE_WORKERS", 1));
+
+    auto splitter_options = util::SplitterOptions::fromEnv(path);
+    auto worker_options = util::WorkerOptions::fromEnv();
+    auto aggregator_options = util::AggregatorOptions::fromEnv();
+    // Один агрегатор на одну задачу
+    splitter_options.shards = 1;
+    worker_options.shards = 1;
+    aggregator_options.shards = 1;
+    aggregator_options.shard = 0;
+    aggregator_options.exit_after = 1;
+
+    auto exporter = util::MetricsExporter::fromEnv();
+    util::InProcBroker broker(util::envSize("LAB2_PIPELINE_QUEUE", 4096));
+
+    util::InProcTransport aggregator_transport(broker);
+    int aggregator_code = 0;
+    std::thread aggregator([&] { aggregator_code = util::runAggregator(aggregator_transport, aggregator_options); });
+
+    std::vector<std::unique_ptr<util::InProcTransport>> worker_transports;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < worker_count; ++i) {
+        auto &transport = *worker_transports.emplace_back(std::make_unique<util::InProcTransport>(broker));
+        workers.emplace_back([&] { util::runWorker(transport, worker_options); });
+    }
+
+    util::InProcTransport splitter_transport(broker);
+    int splitter_code = util::runSplitter(splitter_transport, splitter_options);
+
+    aggregator.join();
+    for (auto &transport : worker_transports) {
+        transport->close();
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    return splitter_code != 0 ? splitter_code : aggregator_code;
+}
@@ -0,0 +1,52 @@
+#include "config.hpp"
+#include "payload_codec.hpp"
+#include "sentence_splitter.hpp"
+#include "wire_format.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+// Обучает словарь zstd для LAB2_ZSTD_DICT на телах задач, нарезанных из корпусов так же, как это делает
+// сплиттер. Результаты воркеров несут тот же текст, поэтому словарь годится и для них.
+//
+//   train_dict <dictionary> <corpus>... [LAB2_CHUNK_SIZE=50] [LAB2_DICT_KB=112]
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        fmt::println("Usage: {} <dictionary> <corpus>...", argv[0]);
+        return 1;
+    }
+    size_t chunk_size = std::max<size_t>(1, util::envSize("LAB2_CHUNK_SIZE", 50));
+    size_t capacity = util::envSize("LAB2_DICT_KB", 112) << 10;
+
+    std::vector<std::string> samples;
+    for (int arg = 2; arg < argc; ++arg) {
+        util::SentenceSplitter splitter;
+        if (!splitter.readAndSplit(argv[arg])) {
+            fmt::println("Cannot read {}", argv[arg]);
+            return 1;
+        }
+        const auto &sentences = splitter.getSentences();
+        for (size_t first = 0; first < sentences.size(); first += chunk_size) {
+            util::wire::TaskMessage task{.chunk = samples.size()};
+            for (size_t i = first; i < std::min(sentences.size(), first + chunk_size); ++i) {
+                task.sentences.push_back(sentences[i]);
+            }
+            samples.push_back(util::wire::encode(task, util::wire::Format::Binary));
+        }
+    }
+
+    auto dictionary = util::trainDictionary(samples, capacity);
+    std::ofstream out(argv[1], std::ios::binary | std::ios::trunc);
+    out.write(dictionary.data(), static_cast<std::streamsize>(dictionary.size()));
+    if (!out) {
+        fmt::println("Cannot write {}", argv[1]);
+        return 1;
+    }
+    fmt::println("Trained a {:.1f} KB dictionary on {} chunks", dictionary.size() / 1024.0, samples.size());
+    return 0;
+}
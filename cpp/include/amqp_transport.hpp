@@ -0,0 +1,77 @@
+#ifndef PARL_LAB2_AMQP_TRANSPORT_HPP
+#define PARL_LAB2_AMQP_TRANSPORT_HPP
+
+#include "loop_executor.hpp"
+#include "transport.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <amqpcpp.h>
+#include <amqpcpp/libev.h>
+#include <ev.h>
+
+namespace util {
+
+// Транспорт через RabbitMQ (AMQP-CPP поверх libev). Очереди durable, надёжная публикация - persistent
+// сообщения с подтверждениями брокера (publisher confirms).
+class AmqpTransport : public Transport {
+public:
+    explicit AmqpTransport(const std::string &host = "localhost", uint16_t port = 5672);
+    ~AmqpTransport() override;
+
+    void declareQueue(const std::string &name, std::function<void()> ready, uint8_t max_priority,
+                      bool temporary) override;
+    void consume(const std::string &queue, size_t prefetch, Consumer consumer) override;
+    void ack(uint64_t delivery_tag, bool multiple) override;
+
+    void publish(const std::string &queue, std::string_view body, std::string_view content_type, uint8_t priority,
+                 std::string_view content_encoding) override;
+    void publishConfirmed(const std::string &queue, std::string_view body, std::string_view content_type,
+                          std::function<void(Confirm)> confirmed, uint8_t priority,
+                          std::string_view content_encoding) override;
+
+    uint64_t startTimer(double seconds, std::function<void()> callback) override;
+    void stopTimer(uint64_t id) override;
+
+    void post(std::function<void()> task) override;
+    void run() override;
+    void close() override;
+
+private:
+    // Закрытое по close() соединение останавливает цикл, даже если в нём остались наблюдатели
+    class Handler : public AMQP::LibEvHandler {
+    public:
+        explicit Handler(struct ev_loop *loop) : AMQP::LibEvHandler(loop), loop(loop) {}
+        void onClosed(AMQP::TcpConnection *connection) override;
+
+    private:
+        struct ev_loop *loop;
+    };
+
+    struct Timer {
+        ev_timer watcher{};
+        AmqpTransport *owner = nullptr;
+        uint64_t id = 0;
+        std::function<void()> callback;
+    };
+
+    static void onTimer(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+    struct ev_loop *loop;
+    Handler handler;
+    AMQP::TcpConnection connection;
+    AMQP::TcpChannel channel;
+    std::unique_ptr<AMQP::Reliable<>> reliable;
+    LoopExecutor executor;
+
+    // Только поток цикла: после close() таймеры не заводятся
+    bool closing = false;
+    std::map<uint64_t, std::unique_ptr<Timer>> timers;
+    uint64_t next_timer = 0;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_AMQP_TRANSPORT_HPP
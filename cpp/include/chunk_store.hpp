@@ -0,0 +1,55 @@
+#ifndef PARL_LAB2_CHUNK_STORE_HPP
+#define PARL_LAB2_CHUNK_STORE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sentence_store.hpp"
+
+namespace util {
+
+// Общее хранилище текстов чанков для компактных результатов (LAB2_CHUNK_STORE - каталог, видимый
+// сплиттеру и агрегатору). Одна задача - один файл <dir>/lab2-<id>.chunks из записей
+//   [uint64 номер чанка][uint32 число предложений][uint32 длины...][байты предложений]
+// Сплиттер дописывает чанки до их публикации, агрегатор читает при финализации и удаляет файл.
+class ChunkWriter {
+public:
+    ChunkWriter(const std::string &dir, uint64_t job);
+
+    void put(uint64_t chunk, const SentenceStore &sentences);
+
+private:
+    std::string path;
+    std::ofstream out;
+};
+
+class ChunkReader {
+public:
+    ChunkReader(const std::string &dir, uint64_t job);
+
+    [[nodiscard]] SentenceStore sentences(uint64_t chunk);
+    [[nodiscard]] std::string sentence(uint64_t chunk, size_t index);
+    // Сколько чанков записал сплиттер к моменту открытия файла
+    [[nodiscard]] size_t chunkCount() const { return chunks.size(); }
+
+    static std::string pathOf(const std::string &dir, uint64_t job);
+
+private:
+    struct Chunk {
+        // offsets[i] - начало предложения i в файле, offsets.back() - конец чанка
+        std::vector<uint64_t> offsets;
+    };
+
+    const Chunk &find(uint64_t chunk) const;
+
+    std::string path;
+    std::ifstream in;
+    std::map<uint64_t, Chunk> chunks;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_CHUNK_STORE_HPP
@@ -0,0 +1,17 @@
+#ifndef PARL_LAB2_CONFIG_HPP
+#define PARL_LAB2_CONFIG_HPP
+
+#include <string>
+
+namespace util {
+
+// Настройки бинарников читаются из переменных окружения (удобно для docker-compose)
+std::string envString(const char *name, const std::string &fallback);
+size_t envSize(const char *name, size_t fallback);
+double envDouble(const char *name, double fallback);
+// LAB2_VERBOSE=1 включает построчный лог каждого сообщения (по умолчанию выключен - он сам тормозит конвейер)
+bool verbose();
+
+} // namespace util
+
+#endif //PARL_LAB2_CONFIG_HPP
@@ -0,0 +1,135 @@
+#ifndef PARL_LAB2_INPROC_TRANSPORT_HPP
+#define PARL_LAB2_INPROC_TRANSPORT_HPP
+
+#include "mpmc_ring.hpp"
+#include "transport.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace util {
+
+// Брокер внутри процесса: именованные очереди на MpmcRing. Сообщения не переживают процесс,
+// поэтому подтверждения публикации приходят сразу, а неподтверждённые доставки не возвращаются в очередь.
+// Очередь с приоритетами - по кольцу на уровень, читатель берёт сообщение из старшего непустого.
+class InProcBroker {
+public:
+    struct Envelope {
+        std::string body;
+        std::string content_type;
+        std::string content_encoding;
+    };
+    using Queue = MpmcRing<Envelope>;
+
+    explicit InProcBroker(size_t queue_capacity = 4096) : queue_capacity(queue_capacity) {}
+
+    void declare(const std::string &name, uint8_t max_priority);
+    // Уровень priority очереди name (не выше объявленного максимума)
+    Queue &queue(const std::string &name, uint8_t priority = 0);
+    // Все уровни очереди, от старшего к младшему
+    std::vector<Queue *> levels(const std::string &name);
+
+    // Счётчик событий (публикации, post(), close()): транспорт запоминает его перед проходом цикла
+    [[nodiscard]] uint64_t events() const { return event_count.load(); }
+    // Отмечает событие и будит спящие транспорты
+    void notify();
+    // Засыпает до deadline, если с момента events() == seen событий не было. Счётчик проверяется под тем же
+    // мьютексом, под которым notify() будит, поэтому событие не может потеряться между проверкой и сном
+    void wait(std::chrono::steady_clock::time_point deadline, uint64_t seen);
+
+    // Транспорт отложил сообщения в полную очередь (waiting = true) или выложил все отложенные
+    void writerWaiting(bool waiting);
+    // Читатель забрал сообщение из очереди: если кто-то ждёт места, будит транспорты
+    void popped();
+
+private:
+    size_t queue_capacity;
+    std::mutex mutex;
+    std::condition_variable woken;
+    std::atomic<uint64_t> event_count{0};
+    std::atomic<int> sleepers{0};
+    std::atomic<int> waiting_writers{0};
+    // Индекс в векторе - приоритет
+    std::map<std::string, std::vector<std::unique_ptr<Queue>>> queues;
+};
+
+// Транспорт одной стадии поверх InProcBroker: свой цикл в потоке, вызвавшем run().
+// Публикация в полную очередь не блокирует цикл - между стадиями есть циклы (ответы о времени чанков,
+// перезапросы агрегатора), и спящий писатель перестал бы разбирать свои очереди. Сообщение откладывается
+// и допубликовывается циклом, когда читатель освободит место; подтверждение publishConfirmed приходит
+// только после этого, поэтому окно сплиттера ограничивает и отложенные сообщения.
+class InProcTransport : public Transport {
+public:
+    explicit InProcTransport(InProcBroker &broker) : broker(broker) {}
+
+    // Очереди живут, пока жив брокер, поэтому temporary ничего не меняет
+    void declareQueue(const std::string &name, std::function<void()> ready, uint8_t max_priority,
+                      bool temporary) override;
+    void consume(const std::string &queue, size_t prefetch, Consumer consumer) override;
+    void ack(uint64_t delivery_tag, bool multiple) override;
+
+    void publish(const std::string &queue, std::string_view body, std::string_view content_type, uint8_t priority,
+                 std::string_view content_encoding) override;
+    void publishConfirmed(const std::string &queue, std::string_view body, std::string_view content_type,
+                          std::function<void(Confirm)> confirmed, uint8_t priority,
+                          std::string_view content_encoding) override;
+
+    uint64_t startTimer(double seconds, std::function<void()> callback) override;
+    void stopTimer(uint64_t id) override;
+
+    void post(std::function<void()> task) override;
+    void run() override;
+    void close() override;
+
+private:
+    struct Subscription {
+        std::vector<InProcBroker::Queue *> levels;
+        size_t prefetch;
+        Consumer consumer;
+        // prefetch считается по подписке, как у consumer в RabbitMQ
+        size_t unacked = 0;
+    };
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        std::function<void()> callback;
+    };
+    struct Pending {
+        InProcBroker::Queue *queue;
+        InProcBroker::Envelope envelope;
+        std::function<void(Confirm)> confirmed;
+    };
+
+    bool runPosted();
+    bool runTimers();
+    bool deliver();
+    bool flushPending();
+    void push(const std::string &queue, std::string_view body, std::string_view content_type, uint8_t priority,
+              std::string_view content_encoding, std::function<void(Confirm)> confirmed);
+
+    InProcBroker &broker;
+    std::atomic<bool> stopping{false};
+
+    std::mutex posted_mutex;
+    std::vector<std::function<void()>> posted;
+    std::atomic<bool> has_posted{false};
+
+    // Дальше - только поток цикла
+    std::vector<Subscription> subscriptions;
+    // delivery tag -> номер подписки
+    std::map<uint64_t, size_t> unacked;
+    uint64_t next_tag = 0;
+    std::map<uint64_t, Timer> timers;
+    uint64_t next_timer = 0;
+    // Сообщения в полные очереди, в порядке публикации
+    std::deque<Pending> pending;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_INPROC_TRANSPORT_HPP
@@ -0,0 +1,34 @@
+#ifndef PARL_LAB2_LOOP_EXECUTOR_HPP
+#define PARL_LAB2_LOOP_EXECUTOR_HPP
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <ev.h>
+
+namespace util {
+
+// Передаёт задачи из любых потоков в поток цикла libev. AMQP-CPP не потокобезопасен,
+// поэтому publish/ack из пула потоков выполняются только через post().
+class LoopExecutor {
+public:
+    explicit LoopExecutor(struct ev_loop *loop);
+    LoopExecutor(const LoopExecutor &) = delete;
+    LoopExecutor &operator=(const LoopExecutor &) = delete;
+    ~LoopExecutor();
+
+    void post(std::function<void()> task);
+
+private:
+    static void onAsync(struct ev_loop *loop, ev_async *watcher, int revents);
+
+    struct ev_loop *loop;
+    ev_async async{};
+    std::mutex mutex;
+    std::vector<std::function<void()>> tasks;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_LOOP_EXECUTOR_HPP
@@ -0,0 +1,157 @@
+#ifndef PARL_LAB2_METRICS_HPP
+#define PARL_LAB2_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace util {
+
+class Counter {
+public:
+    void add(uint64_t value = 1) { total.fetch_add(value, std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t value() const { return total.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> total{0};
+};
+
+// Гистограмма длительностей в микросекундах. Корзина i считает значения с bit_width(value) == i,
+// т.е. границы - степени двойки; запись - два relaxed fetch_add без блокировок.
+class Histogram {
+public:
+    static constexpr size_t BUCKETS = 64;
+
+    void record(uint64_t micros)
+    {
+        buckets[std::bit_width(micros)].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(micros, std::memory_order_relaxed);
+    }
+
+    struct Snapshot {
+        std::array<uint64_t, BUCKETS + 1> buckets{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+
+        // Верхняя граница корзины, в которую попал перцентиль
+        [[nodiscard]] uint64_t percentile(double p) const;
+    };
+    [[nodiscard]] Snapshot snapshot() const;
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS + 1> buckets{};
+    std::atomic<uint64_t> sum{0};
+};
+
+// Значение метки Prometheus в кавычках: \, " и перевод строки экранируются
+std::string labelValue(std::string_view value);
+
+// Значения с метками, которые появляются и исчезают вместе с объектами (например, прогресс задач).
+// labels - готовый текст меток Prometheus: job="1",tenant="a"; пришедшие извне значения - через labelValue
+class GaugeFamily {
+public:
+    void set(const std::string &labels, double value)
+    {
+        std::lock_guard lock(mutex);
+        values[labels] = value;
+    }
+    void erase(const std::string &labels)
+    {
+        std::lock_guard lock(mutex);
+        values.erase(labels);
+    }
+    [[nodiscard]] std::map<std::string, double> snapshot() const
+    {
+        std::lock_guard lock(mutex);
+        return values;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::string, double> values;
+};
+
+// Замеряет время жизни объекта
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram &histogram) : histogram(histogram), started(std::chrono::steady_clock::now()) {}
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+    ~ScopedTimer()
+    {
+        histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                               started)
+                             .count());
+    }
+
+private:
+    Histogram &histogram;
+    std::chrono::steady_clock::time_point started;
+};
+
+// Реестр метрик процесса. Регистрация под мьютексом, запись в уже полученные ссылки - без блокировок.
+class Metrics {
+public:
+    static Metrics &global();
+
+    Counter &counter(const std::string &name, const std::string &help);
+    // Имя без суффикса: в тексте Prometheus значения в секундах, _bucket/_sum/_count
+    Histogram &histogram(const std::string &name, const std::string &help);
+    GaugeFamily &gauges(const std::string &name, const std::string &help);
+
+    // Формат Prometheus text exposition 0.0.4
+    [[nodiscard]] std::string prometheus() const;
+    // Короткая сводка для периодического вывода: count, mean, p50, p99
+    [[nodiscard]] std::string summary() const;
+
+private:
+    template <typename T>
+    struct Entry {
+        std::string name;
+        std::string help;
+        std::unique_ptr<T> metric;
+    };
+
+    mutable std::mutex mutex;
+    std::deque<Entry<Counter>> counters;
+    std::deque<Entry<Histogram>> histograms;
+    std::deque<Entry<GaugeFamily>> gauge_families;
+};
+
+// Отдаёт метрики по HTTP (GET на любой путь, LAB2_METRICS_PORT) и/или печатает сводку
+// в stderr раз в LAB2_METRICS_DUMP_S секунд. Ноль - выключено. По умолчанию слушает только localhost,
+// LAB2_METRICS_ADDR=0.0.0.0 открывает порт наружу.
+class MetricsExporter {
+public:
+    MetricsExporter(uint16_t port, double dump_interval, const std::string &address = "127.0.0.1");
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+    ~MetricsExporter();
+
+    static std::unique_ptr<MetricsExporter> fromEnv();
+
+private:
+    void serve();
+    void dump(double interval);
+
+    int listen_fd = -1;
+    std::thread server;
+    std::thread dumper;
+    std::mutex mutex;
+    std::condition_variable stop_requested;
+    bool stopping = false;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_METRICS_HPP
@@ -0,0 +1,93 @@
+#ifndef PARL_LAB2_MPMC_RING_HPP
+#define PARL_LAB2_MPMC_RING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace util {
+
+// Ограниченная lock-free очередь для многих писателей и читателей (схема Вьюкова): у каждой ячейки
+// свой номер последовательности, писатели и читатели захватывают позиции через CAS и не ждут друг друга.
+template <typename T>
+class MpmcRing {
+public:
+    explicit MpmcRing(size_t capacity)
+        : capacity(std::bit_ceil(std::max<size_t>(capacity, 2))), mask(this->capacity - 1),
+          cells(std::make_unique<Cell[]>(this->capacity))
+    {
+        for (size_t i = 0; i < this->capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcRing(const MpmcRing &) = delete;
+    MpmcRing &operator=(const MpmcRing &) = delete;
+
+    bool tryPush(T &&value)
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // полна
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T &value)
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // пуста
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Приблизительно: для решения "можно ли уснуть", не для синхронизации
+    [[nodiscard]] bool empty() const
+    {
+        return head.load(std::memory_order_seq_cst) == tail.load(std::memory_order_seq_cst);
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    size_t capacity;
+    size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<size_t> head{0};
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_MPMC_RING_HPP
@@ -0,0 +1,63 @@
+#ifndef PARL_LAB2_NAME_SCANNER_HPP
+#define PARL_LAB2_NAME_SCANNER_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "word_counter.hpp"
+
+namespace util {
+
+// Справочник имён, по одному имени на строку. Сравнение с учётом регистра.
+class Gazetteer {
+public:
+    Gazetteer() = default;
+    static Gazetteer load(const std::string &filename);
+
+    void add(std::string_view name);
+    [[nodiscard]] bool contains(std::string_view word) const;
+    [[nodiscard]] size_t size() const;
+
+private:
+    WordCounter names;
+};
+
+struct NameRules {
+    // Слово целиком вида [A-Z][a-z]* - то же, что регулярка \b[A-Z][a-z]*\b
+    bool capitalized = true;
+    // Не считать именем первое слово предложения (оно с заглавной буквы просто по правилам письма).
+    // Слова из справочника заменяются и в начале предложения.
+    bool skip_sentence_initial = false;
+    const Gazetteer *gazetteer = nullptr;
+};
+
+// Линейный однопроходный поиск имён. Словом считается максимальная последовательность
+// [A-Za-z0-9_], как у \b в std::regex. Без справочника кандидаты ищутся по заглавным буквам
+// блоками по 16/32 байта (SSE2/AVX2), остальной текст копируется целиком.
+class NameScanner {
+public:
+    // Найденное имя - байты [offset, offset + length) предложения
+    struct Span {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    explicit NameScanner(NameRules rules = {});
+
+    void replace(std::string_view sentence, std::string_view replacement, std::string &out) const;
+    [[nodiscard]] std::string replace(std::string_view sentence, std::string_view replacement) const;
+    // Только позиции имён, без копирования текста; дописывает в out по порядку
+    void find(std::string_view sentence, std::vector<Span> &out) const;
+
+private:
+    template <typename OnName>
+    void scan(std::string_view sentence, OnName on_name) const;
+
+    NameRules rules;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_NAME_SCANNER_HPP
@@ -0,0 +1,62 @@
+#ifndef PARL_LAB2_PAYLOAD_CODEC_HPP
+#define PARL_LAB2_PAYLOAD_CODEC_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace util {
+
+// Сжатие тел сообщений. Кодек передаётся в заголовке content-encoding, без заголовка тело не сжато,
+// поэтому стадии со сжатием и без него понимают друг друга. lz4 - блок с длиной исходника (u32 LE) впереди,
+// zstd - обычный кадр, при словаре - с его id.
+enum class Codec { None, Lz4, Zstd };
+
+struct CompressionOptions {
+    Codec codec = Codec::None;
+    // Тела короче не сжимаются: заголовки кадра и время на сжатие съедают выигрыш
+    size_t min_bytes = 1024;
+    int level = 3;
+    // Словарь zstd (train_dict): короткие чанки прозы сжимаются им заметно лучше. Нужен обеим сторонам.
+    std::string dictionary;
+
+    // LAB2_COMPRESSION=none|lz4|zstd, LAB2_COMPRESSION_MIN, LAB2_ZSTD_LEVEL, LAB2_ZSTD_DICT
+    static CompressionOptions fromEnv();
+};
+
+Codec codecFromName(std::string_view name);
+// Значение content-encoding; у Codec::None - пустая строка
+std::string_view codecName(Codec codec);
+
+// Потокобезопасен: словари общие и только читаются, контексты zstd - свои у каждого потока
+class PayloadCodec {
+public:
+    explicit PayloadCodec(CompressionOptions options);
+    ~PayloadCodec();
+    PayloadCodec(const PayloadCodec &) = delete;
+    PayloadCodec &operator=(const PayloadCodec &) = delete;
+
+    // Сжимает body на месте, если оно не короче min_bytes и стало меньше; возвращает content-encoding
+    std::string_view compress(std::string &body) const;
+    // Исходное тело сообщения с заголовком content_encoding: несжатое возвращается как есть, сжатое
+    // разжимается в buffer
+    std::string_view decompress(std::string_view body, std::string_view content_encoding, std::string &buffer) const;
+
+    [[nodiscard]] Codec codec() const { return options.codec; }
+
+private:
+    CompressionOptions options;
+    ZSTD_CDict_s *compress_dictionary = nullptr;
+    ZSTD_DDict_s *decompress_dictionary = nullptr;
+};
+
+// Словарь zstd по образцам тел сообщений; capacity - предел размера словаря в байтах
+std::string trainDictionary(const std::vector<std::string> &samples, size_t capacity);
+
+} // namespace util
+
+#endif //PARL_LAB2_PAYLOAD_CODEC_HPP
@@ -0,0 +1,50 @@
+#ifndef PARL_LAB2_RESULT_CACHE_HPP
+#define PARL_LAB2_RESULT_CACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace util {
+
+// Хеш текста чанка (XXH3): длины предложений входят в хеш, так что границы предложений тоже учитываются
+uint64_t chunkHash(std::span<const std::string_view> sentences);
+
+uint64_t bytesHash(std::string_view bytes);
+// Ключ кэша: хеш чанка плюс хеш настроек анализа, от которых зависит результат
+uint64_t cacheKey(uint64_t chunk_hash, uint64_t config_hash);
+
+// Кэш закодированных результатов чанков: LRU в памяти с лимитом в байтах и необязательный каталог на диске
+// (<dir>/<ключ>.lab2c, переживает перезапуск и может быть общим у воркеров). Потокобезопасен.
+class ResultCache {
+public:
+    // capacity - байт в памяти (0 - только диск), dir - каталог на диске ("" - только память)
+    ResultCache(size_t capacity, std::string dir);
+
+    std::optional<std::string> get(uint64_t key);
+    void put(uint64_t key, const std::string &value);
+    // Убирает запись из памяти и с диска - например, если она не декодируется
+    void erase(uint64_t key);
+
+private:
+    // Вызывается под mutex
+    void remember(uint64_t key, std::string value);
+    [[nodiscard]] std::string pathOf(uint64_t key) const;
+
+    size_t capacity;
+    std::string dir;
+    std::mutex mutex;
+    size_t used = 0;
+    // Спереди - недавно использованные
+    std::list<std::pair<uint64_t, std::string>> entries;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, std::string>>::iterator> index;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_RESULT_CACHE_HPP
@@ -0,0 +1,91 @@
+#ifndef PARL_LAB2_RESULT_SINK_HPP
+#define PARL_LAB2_RESULT_SINK_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+// Запись в файл через фоновый поток: вызывающий только копирует данные в буфер, полные буферы
+// пишет поток-писатель. Очередь ограничена depth буферами, дальше write() ждёт диск.
+class BufferedWriter {
+public:
+    explicit BufferedWriter(const std::string &path, size_t buffer_size = 1 << 20, size_t depth = 4);
+    BufferedWriter(const BufferedWriter &) = delete;
+    BufferedWriter &operator=(const BufferedWriter &) = delete;
+    ~BufferedWriter();
+
+    void write(std::string_view data);
+    // Дописывает всё и закрывает файл; ошибку записи бросает отсюда
+    void close();
+    [[nodiscard]] uint64_t written() const { return total; }
+
+private:
+    void hand(std::string buffer);
+    void run();
+
+    int fd = -1;
+    std::string path;
+    size_t buffer_size;
+    size_t depth;
+    std::string current;
+    uint64_t total = 0;
+
+    std::deque<std::string> queue;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool closing = false;
+    int error = 0;
+    std::thread writer;
+};
+
+// Итоговые числа задачи, без предложений
+struct JobSummary {
+    uint64_t id = 0;
+    uint64_t total_chunks = 0;
+    std::vector<uint64_t> word_counts;
+    uint64_t total_words = 0;
+    uint64_t sentences = 0;
+    size_t positive = 0;
+    size_t negative = 0;
+    int64_t sentiment = 0;
+    std::vector<std::pair<std::string, size_t>> top_words;
+    int64_t duration_ms = 0;
+    // Задача закрыта по таймауту: результат неполный, этих чанков нет (при неизвестном total_chunks - только
+    // пропуски среди полученных номеров)
+    bool complete = true;
+    std::vector<uint64_t> missing_chunks;
+};
+
+// Приёмник полного результата задачи. Порядок вызовов: summary, все sorted, все replaced, close.
+//   ndjson   - <id>.ndjson: строка-итог, затем по строке на предложение;
+//   columnar - <id>.lab2r: итог, затем колонки предложений подряд, длины строк - в конце файла.
+class ResultSink {
+public:
+    enum class Format { None, NdJson, Columnar };
+
+    virtual ~ResultSink() = default;
+
+    // LAB2_SINK=ndjson|columnar|none
+    static Format formatFromEnv();
+    // nullptr для Format::None
+    static std::unique_ptr<ResultSink> open(Format format, const std::string &dir, uint64_t id);
+
+    virtual void summary(const JobSummary &summary) = 0;
+    virtual void sorted(std::string_view sentence) = 0;
+    virtual void replaced(std::string_view sentence) = 0;
+    virtual void close() = 0;
+    [[nodiscard]] virtual std::string path() const = 0;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_RESULT_SINK_HPP
@@ -0,0 +1,61 @@
+#ifndef PARL_LAB2_RUN_STORE_HPP
+#define PARL_LAB2_RUN_STORE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+
+// Хранилище "прогонов" предложений от чанков. Пока прогоны помещаются в лимит памяти, они лежат
+// в памяти; при превышении сбрасываются в файл во временном каталоге и дальше читаются потоково.
+//   ByLength - каждый прогон уже отсортирован по убыванию длины, выдача - k-way слияние прогонов
+//              (при сбросе прогоны из памяти сначала сливаются в один отсортированный сегмент);
+//              равные по длине выдаются по номеру прогона, затем по позиции в нём, со сбросами или без;
+//   ByRunId  - выдача - прогоны подряд в порядке их номеров (номер чанка).
+class RunStore {
+public:
+    enum class Order { ByLength, ByRunId };
+    // Возвращает false, чтобы остановить выдачу
+    using Callback = std::function<bool(std::string_view)>;
+
+    RunStore(Order order, std::string spill_dir, size_t memory_limit);
+    RunStore(const RunStore &) = delete;
+    RunStore &operator=(const RunStore &) = delete;
+    ~RunStore();
+
+    void add(uint64_t run_id, std::vector<std::string> run);
+    void forEach(const Callback &callback) const;
+
+    [[nodiscard]] size_t memoryUsage() const { return memory; }
+    [[nodiscard]] size_t spilledBytes() const { return spilled; }
+
+private:
+    struct Segment {
+        size_t file = 0;
+        uint64_t offset = 0;
+        size_t count = 0;
+    };
+
+    void spill();
+    void mergeByLength(const Callback &callback) const;
+    void concatenate(const Callback &callback) const;
+
+    Order order;
+    std::string spill_dir;
+    size_t memory_limit;
+    size_t memory = 0;
+    size_t spilled = 0;
+
+    std::map<uint64_t, std::vector<std::string>> runs;
+    std::vector<std::string> files;
+    // ByLength: один сегмент на сброс; ByRunId: по сегменту на каждый сброшенный прогон
+    std::multimap<uint64_t, Segment> segments;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_RUN_STORE_HPP
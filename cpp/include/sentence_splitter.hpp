@@ -3,26 +3,74 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
+#include <optional>
 #include <algorithm>
 #include <unordered_set>
 
+#include "sentence_store.hpp"
+
 namespace util {
 
+// Read-only отображение файла в память. Страницы подгружаются ядром по мере чтения,
+// поэтому резидентная память не растёт вместе с размером корпуса.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &filename);
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    [[nodiscard]] std::string_view view() const;
+
+private:
+    void *data = nullptr;
+    size_t size = 0;
+};
+
+// Потоковый разбор текста на предложения: каждое next() отдаёт следующее предложение.
+// Возвращаемый view указывает либо прямо в исходный текст (если чистка не нужна), либо во
+// внутренний буфер, и действителен только до следующего вызова next().
+class SentenceStream {
+public:
+    explicit SentenceStream(std::string_view text);
+    static SentenceStream fromFile(const std::string &filename);
+
+    std::optional<std::string_view> next();
+    [[nodiscard]] size_t bytesConsumed() const;
+    [[nodiscard]] size_t totalBytes() const;
+
+private:
+    std::optional<MappedFile> file;
+    std::string_view text;
+    size_t position = 0;
+    std::string buffer;
+};
+
 class SentenceSplitter {
 public:
     SentenceSplitter() = default;
-    bool readAndSplit(const std::string &filename);
-    bool splitSentences(const std::string &text);
-    [[nodiscard]] const std::vector<std::string> &getSentences() const;
+    bool readAndSplit(const std::string &filename, size_t threads = 1);
+    bool splitSentences(std::string_view text);
+    // Текст режется на диапазоны по пробельным символам, каждый разбирается в своём потоке.
+    // Результат совпадает с splitSentences.
+    bool splitSentencesParallel(std::string_view text, size_t threads);
+    [[nodiscard]] const SentenceStore &getSentences() const;
     void saveToFile(const std::string &filename) const;
 
 private:
-    static std::string cleanSentence(const std::string &sentence);
-    static bool isAbbreviation(const std::string &text, size_t pos);
+    friend class SentenceStream;
+
+    static std::string_view cleanSentence(std::string_view sentence, std::string &buffer);
+    static bool isAbbreviation(std::string_view text, size_t pos);
+    // Конец предложения, начатого не позже from, с точкой/знаком в [from, limit); npos, если его нет
+    static size_t findSentenceEnd(std::string_view text, size_t from, size_t limit);
 
-    std::vector<std::string> sentences;
+    SentenceStore sentences;
 };
 
 }
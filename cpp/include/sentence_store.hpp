@@ -0,0 +1,112 @@
+#ifndef PARL_LAB2_SENTENCE_STORE_HPP
+#define PARL_LAB2_SENTENCE_STORE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+
+// Предложения в одном непрерывном буфере с индексом (смещение, длина): два выделения памяти
+// на любое число предложений вместо одного на каждое. Буфер только растёт до clear(), поэтому
+// view, полученные до очередного add(), после него могут стать недействительными.
+class SentenceStore {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string_view;
+
+        Iterator() = default;
+        Iterator(const SentenceStore *store, size_t index) : store(store), index(index) {}
+
+        std::string_view operator*() const { return (*store)[index]; }
+        Iterator &operator++()
+        {
+            ++index;
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto copy = *this;
+            ++index;
+            return copy;
+        }
+        bool operator==(const Iterator &other) const { return index == other.index; }
+
+    private:
+        const SentenceStore *store = nullptr;
+        size_t index = 0;
+    };
+
+    void reserve(size_t bytes, size_t count)
+    {
+        buffer.reserve(bytes);
+        spans.reserve(count);
+    }
+
+    void add(std::string_view sentence)
+    {
+        spans.push_back({buffer.size(), sentence.size()});
+        buffer.append(sentence);
+    }
+
+    // Предложение собирается прямо в конце буфера: write(std::string &buffer) дописывает его туда
+    template <typename Write>
+    void emplace(Write write)
+    {
+        size_t offset = buffer.size();
+        write(buffer);
+        spans.push_back({offset, buffer.size() - offset});
+    }
+
+    void append(const SentenceStore &other)
+    {
+        for (auto sentence : other) {
+            add(sentence);
+        }
+    }
+
+    void clear()
+    {
+        buffer.clear();
+        spans.clear();
+    }
+
+    [[nodiscard]] std::string_view operator[](size_t index) const
+    {
+        return std::string_view(buffer).substr(spans[index].offset, spans[index].length);
+    }
+    [[nodiscard]] size_t size() const { return spans.size(); }
+    [[nodiscard]] bool empty() const { return spans.empty(); }
+    [[nodiscard]] size_t bytes() const { return buffer.size(); }
+
+    [[nodiscard]] Iterator begin() const { return {this, 0}; }
+    [[nodiscard]] Iterator end() const { return {this, spans.size()}; }
+    [[nodiscard]] std::vector<std::string_view> views() const { return {begin(), end()}; }
+
+    bool operator==(const SentenceStore &other) const
+    {
+        return size() == other.size() && std::equal(begin(), end(), other.begin());
+    }
+
+private:
+    struct Span {
+        size_t offset;
+        size_t length;
+    };
+
+    std::string buffer;
+    std::vector<Span> spans;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_SENTENCE_STORE_HPP
@@ -0,0 +1,83 @@
+#ifndef PARL_LAB2_SENTIMENT_LEXICON_HPP
+#define PARL_LAB2_SENTIMENT_LEXICON_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace util::lexicon {
+
+struct Entry {
+    std::string_view word;
+    int polarity = 0; // +1 положительное, -1 отрицательное
+};
+
+inline constexpr std::array<Entry, 36> SENTIMENT_WORDS{{
+        {"good", 1},      {"great", 1},       {"excellent", 1},   {"amazing", 1},   {"wonderful", 1},
+        {"fantastic", 1}, {"awesome", 1},     {"happy", 1},       {"joy", 1},       {"love", 1},
+        {"nice", 1},      {"beautiful", 1},   {"perfect", 1},     {"brilliant", 1}, {"outstanding", 1},
+        {"superb", 1},    {"marvelous", 1},   {"delightful", 1},  {"bad", -1},      {"terrible", -1},
+        {"awful", -1},    {"horrible", -1},   {"sad", -1},        {"unhappy", -1},  {"hate", -1},
+        {"worst", -1},    {"boring", -1},     {"dislike", -1},    {"angry", -1},    {"hateful", -1},
+        {"disgusting", -1}, {"ugly", -1},     {"stupid", -1},     {"dumb", -1},     {"annoying", -1},
+        {"disappointing", -1},
+}};
+
+constexpr uint64_t hash(std::string_view word, uint64_t seed)
+{
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (char c : word) {
+        h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    return h ^ (h >> 29);
+}
+
+// Совершенный хеш, подобранный при компиляции: перебираем seed, пока все слова словаря
+// не попадут в разные слоты. Поиск - одно хеширование и одно сравнение строк.
+template <size_t N, size_t TableSize>
+class PerfectHashSet {
+    static_assert((TableSize & (TableSize - 1)) == 0, "TableSize must be a power of two");
+
+public:
+    constexpr explicit PerfectHashSet(const std::array<Entry, N> &entries)
+    {
+        for (uint64_t candidate = 0;; ++candidate) {
+            std::array<bool, TableSize> taken{};
+            bool collision = false;
+            for (const auto &entry : entries) {
+                size_t index = hash(entry.word, candidate) & (TableSize - 1);
+                if (taken[index]) {
+                    collision = true;
+                    break;
+                }
+                taken[index] = true;
+            }
+            if (!collision) {
+                seed = candidate;
+                break;
+            }
+        }
+
+        for (const auto &entry : entries) {
+            table[hash(entry.word, seed) & (TableSize - 1)] = entry;
+        }
+    }
+
+    [[nodiscard]] constexpr int polarity(std::string_view word) const
+    {
+        const Entry &entry = table[hash(word, seed) & (TableSize - 1)];
+        return entry.word == word ? entry.polarity : 0;
+    }
+
+private:
+    uint64_t seed = 0;
+    std::array<Entry, TableSize> table{};
+};
+
+inline constexpr PerfectHashSet<SENTIMENT_WORDS.size(), 128> SENTIMENT{SENTIMENT_WORDS};
+
+static_assert(SENTIMENT.polarity("good") == 1 && SENTIMENT.polarity("ugly") == -1 && SENTIMENT.polarity("whale") == 0);
+
+} // namespace util::lexicon
+
+#endif //PARL_LAB2_SENTIMENT_LEXICON_HPP
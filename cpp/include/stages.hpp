@@ -0,0 +1,122 @@
+#ifndef PARL_LAB2_STAGES_HPP
+#define PARL_LAB2_STAGES_HPP
+
+#include "payload_codec.hpp"
+#include "result_sink.hpp"
+#include "transport.hpp"
+#include "wire_format.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+// Стадии конвейера поверх Transport. Каждая run*-функция крутит цикл транспорта в вызвавшем потоке
+// и возвращается после transport.close(); бинарники и in-process конвейер отличаются только транспортом.
+
+struct SplitterOptions {
+    std::string path;
+    // Предел числа предложений в чанке; 0 - без предела (только при бюджете в байтах)
+    size_t chunk_size = 50;
+    // Чанк закрывается, набрав столько байт предложений; 0 - только по числу предложений
+    size_t chunk_bytes = 0;
+    // Больше нуля - бюджет в байтах подстраивается по отзывам воркеров так, чтобы чанк обрабатывался
+    // примерно за это время (секунды)
+    double target_latency = 0;
+    // Каталог ChunkStore: тексты чанков пишутся туда, воркеры отвечают компактными результатами
+    std::string chunk_store;
+    // Больше одного - параллельный разбор всего файла заранее, иначе потоковый по мере публикации
+    size_t threads = 1;
+    // Сколько неподтверждённых брокером сообщений может быть в полёте одновременно
+    size_t window = 64;
+    // Задачи арендатора идут в его очередь (wire::taskQueue). Приоритет по умолчанию тем выше, чем меньше файл,
+    // чтобы короткие задачи не ждали за большими корпусами.
+    std::string tenant;
+    uint8_t priority = 0;
+    // Какие анализы нужны задаче (LAB2_ANALYSES, маска util::Analysis); 0 - все
+    uint32_t analyses = 0;
+    // Общий с воркерами каталог кэша результатов: чанк, результат которого там уже есть, уходит прямо
+    // агрегатору, минуя очередь задач и воркеров. "" - все чанки публикуются воркерам
+    std::string cache_dir;
+    // resultConfigHash настроек воркеров из того же окружения - без совпадения ключей попаданий не будет
+    uint64_t cache_config = 0;
+    // Должно совпадать с shards у агрегаторов: туда уходят результаты из кэша
+    size_t shards = 1;
+    wire::Format format = wire::Format::Binary;
+    CompressionOptions compression;
+
+    static SplitterOptions fromEnv(std::string path);
+};
+
+// Возвращает код выхода процесса
+int runSplitter(Transport &transport, const SplitterOptions &options);
+
+struct WorkerOptions {
+    // Очереди арендаторов (wire::taskQueue, "" - общая task_queue) и их веса: при нехватке потоков
+    // задачи из очередей берутся пропорционально весам
+    std::vector<std::pair<std::string, size_t>> tenants{{"", 1}};
+    size_t threads = 1;
+    size_t batch_results = 16;
+    size_t batch_bytes = 1 << 20;
+    double batch_delay = 0.05;
+    size_t prefetch = 32;
+    // Должно совпадать с shards у агрегаторов
+    size_t shards = 1;
+    bool skip_sentence_initial = false;
+    std::string gazetteer;
+    // Кэш результатов по хешу чанка: лимит памяти (0 - без LRU в памяти) и каталог на диске ("" - без диска)
+    size_t cache_bytes = 64 << 20;
+    std::string cache_dir;
+    wire::Format format = wire::Format::Binary;
+    // Сжатие пачек результатов; сжатые задачи воркер разжимает при любых настройках
+    CompressionOptions compression;
+
+    static WorkerOptions fromEnv();
+};
+
+void runWorker(Transport &transport, const WorkerOptions &options);
+
+// Кэш результатов чанков общий у воркеров и сплиттера, поэтому ключ считается в одном месте.
+// Хеш настроек воркера, от которых зависит результат: версия и формат сообщений, правила имён, вид результата
+uint64_t resultConfigHash(const WorkerOptions &options, bool compact);
+// Ключ ResultCache: хеш текста чанка, набор анализов задачи (0 - все) и resultConfigHash
+uint64_t resultCacheKey(uint64_t chunk_hash, uint32_t analyses, uint64_t config_hash);
+// Результат из кэша в конверте задачи task: её id, номер чанка и метки времени
+std::string restampResult(std::string_view cached, const wire::TaskMessage &task, wire::Format format);
+
+struct AggregatorOptions {
+    size_t top_n = 10;
+    // Лимит памяти под предложения одной задачи (на оба её RunStore вместе), сверх него прогоны
+    // сбрасываются во временные файлы
+    size_t memory_limit = 256 << 20;
+    std::string spill_dir;
+    ResultSink::Format sink_format = ResultSink::Format::None;
+    std::string output_dir = ".";
+    // Каталог ChunkStore, из которого восстанавливается текст компактных результатов
+    std::string chunk_store;
+    // Этот экземпляр обрабатывает задачи шарда shard из shards (см. wire::shardOf)
+    size_t shards = 1;
+    size_t shard = 0;
+    size_t threads = 2;
+    // Задача, по которой столько секунд не приходило новых чанков, считается застрявшей (0 - ждать вечно).
+    // Недостающие чанки перезапрашиваются из ChunkStore до job_retries раз, затем задача закрывается
+    // неполной со списком пропавших чанков.
+    double job_timeout = 120;
+    size_t job_retries = 3;
+    // Раз в столько секунд печатать прогресс открытых задач (0 - не печатать); в метриках он есть всегда
+    double progress_interval = 10;
+    // Для бенчмарков: закрыть транспорт после стольких задач (0 - работать бесконечно) и записать отчёт
+    size_t exit_after = 0;
+    std::string report_path;
+    // Для перезапрошенных задач и словаря zstd
+    CompressionOptions compression;
+
+    static AggregatorOptions fromEnv();
+};
+
+int runAggregator(Transport &transport, const AggregatorOptions &options);
+
+} // namespace util
+
+#endif //PARL_LAB2_STAGES_HPP
@@ -0,0 +1,36 @@
+#ifndef PARL_LAB2_THREAD_POOL_HPP
+#define PARL_LAB2_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+// Фиксированный пул потоков с общей очередью задач. Деструктор дожидается выполнения всех задач.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+    [[nodiscard]] size_t size() const;
+
+private:
+    void run();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping = false;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_THREAD_POOL_HPP
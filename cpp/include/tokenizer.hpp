@@ -0,0 +1,59 @@
+#ifndef PARL_LAB2_TOKENIZER_HPP
+#define PARL_LAB2_TOKENIZER_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+
+// Слово - байты [offset, offset + length) текста
+struct Token {
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+// Набор инструкций ядер токенизатора. Выбирается один раз при первом вызове по возможностям процессора;
+// LAB2_SIMD=scalar|sse42|avx2 может только понизить уровень (для сравнения в бенчмарке).
+enum class SimdLevel { Scalar, Sse42, Avx2 };
+
+SimdLevel simdLevel();
+SimdLevel supportedSimdLevel();
+std::string_view simdName(SimdLevel level);
+
+// Слова - максимальные последовательности байтов, не являющихся пробелами ASCII (как isspace в локали "C");
+// точка в конце слова отрезается. Маска пробелов считается блоками по 16/32 байта, дописывает в tokens.
+void tokenize(std::string_view text, std::vector<Token> &tokens);
+void tokenize(std::string_view text, std::vector<Token> &tokens, SimdLevel level);
+
+// То же плюс за тот же проход пишет текст в нижнем регистре в lower (text.size() байт): ASCII и кириллица
+// в UTF-8 (А-Я, Ѐ-Џ), остальные байты как есть. Длина при этом не меняется, поэтому слова в lower лежат
+// по тем же смещениям, что и в text.
+void tokenizeLower(std::string_view text, char *lower, std::vector<Token> &tokens);
+void tokenizeLower(std::string_view text, char *lower, std::vector<Token> &tokens, SimdLevel level);
+
+// Переиспользуемый буфер под текст в нижнем регистре и слова одного предложения
+class LowerArena {
+public:
+    void tokenize(std::string_view text)
+    {
+        lower.resize(text.size());
+        tokens.clear();
+        tokenizeLower(text, lower.data(), tokens);
+    }
+
+    [[nodiscard]] const std::vector<Token> &words() const { return tokens; }
+    [[nodiscard]] std::string_view word(Token token) const
+    {
+        return std::string_view(lower).substr(token.offset, token.length);
+    }
+
+private:
+    std::string lower;
+    std::vector<Token> tokens;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_TOKENIZER_HPP
@@ -0,0 +1,60 @@
+#ifndef PARL_LAB2_TRANSPORT_HPP
+#define PARL_LAB2_TRANSPORT_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+// Транспорт между стадиями конвейера. Все колбэки (consume, подтверждения, таймеры, post) выполняются
+// в одном потоке транспорта - том, что вызвал run(); остальные методы тоже вызываются из него,
+// кроме post() и close(), которые можно звать из любого потока.
+class Transport {
+public:
+    struct Message {
+        // Действительны только внутри колбэка consume
+        std::string_view body;
+        std::string_view content_type;
+        // Кодек сжатия тела ("lz4", "zstd"); пусто - тело не сжато
+        std::string_view content_encoding;
+        uint64_t delivery_tag = 0;
+        // Брокер уже доставлял это сообщение (потребитель упал или не подтвердил его) - возможен повтор
+        bool redelivered = false;
+    };
+    enum class Confirm { Ack, Nack, Lost };
+
+    using Consumer = std::function<void(const Message &)>;
+
+    virtual ~Transport() = default;
+
+    // max_priority > 0 - очередь с приоритетами 0..max_priority (x-max-priority у RabbitMQ).
+    // temporary - очередь только этого соединения: читает её лишь оно, и она удаляется после его закрытия
+    virtual void declareQueue(const std::string &name, std::function<void()> ready = {}, uint8_t max_priority = 0,
+                              bool temporary = false) = 0;
+    // prefetch - сколько неподтверждённых сообщений может быть на руках, 0 - без ограничения
+    virtual void consume(const std::string &queue, size_t prefetch, Consumer consumer) = 0;
+    virtual void ack(uint64_t delivery_tag, bool multiple = false) = 0;
+
+    // priority учитывается только очередями, объявленными с max_priority
+    virtual void publish(const std::string &queue, std::string_view body, std::string_view content_type,
+                         uint8_t priority = 0, std::string_view content_encoding = {}) = 0;
+    // Надёжная публикация: сообщение сохраняется брокером, результат приходит в confirmed
+    virtual void publishConfirmed(const std::string &queue, std::string_view body, std::string_view content_type,
+                                  std::function<void(Confirm)> confirmed, uint8_t priority = 0,
+                                  std::string_view content_encoding = {}) = 0;
+
+    // Одноразовый таймер; id для stopTimer. После close() таймеры могут не заводиться и не срабатывать
+    virtual uint64_t startTimer(double seconds, std::function<void()> callback) = 0;
+    virtual void stopTimer(uint64_t id) = 0;
+
+    virtual void post(std::function<void()> task) = 0;
+    // Крутит цикл до close(); оставшиеся таймеры выхода не задерживают
+    virtual void run() = 0;
+    virtual void close() = 0;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_TRANSPORT_HPP
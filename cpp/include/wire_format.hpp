@@ -0,0 +1,139 @@
+#ifndef PARL_LAB2_WIRE_FORMAT_HPP
+#define PARL_LAB2_WIRE_FORMAT_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace util::wire {
+
+// Бинарный формат сообщений:
+//   'L' '2' | version (u8) | kind (u8) | поля сообщения
+// Целые числа кодируются как LEB128 varint, строки - varint длина + байты.
+// Декодированные сообщения ссылаются прямо в тело AMQP-сообщения, поэтому живут не дольше него.
+inline constexpr uint8_t VERSION = 8;
+
+enum class Format { Binary, Json };
+enum class Kind : uint8_t { Task = 1, Result = 2, ResultBatch = 3, Feedback = 4 };
+
+inline constexpr std::string_view BINARY_CONTENT_TYPE = "application/x-lab2";
+inline constexpr std::string_view JSON_CONTENT_TYPE = "application/json";
+
+// LAB2_WIRE_FORMAT=json включает JSON для отладки, по умолчанию - бинарный формат
+Format formatFromEnv();
+std::string_view contentType(Format format);
+// Сообщения без content-type считаются JSON (так публиковали старые версии)
+Format formatOf(std::string_view contentType);
+
+// Метки времени - микросекунды system_clock (nowMicros), по ним считаются задержки этапов конвейера
+uint64_t nowMicros();
+
+struct TaskMessage {
+    uint64_t id = 0;
+    uint64_t chunk = 0;
+    uint64_t total = 0;
+    uint64_t sent_us = 0;
+    // Сплиттер ждёт FeedbackMessage о времени обработки этого чанка
+    bool feedback = false;
+    // Текст чанка лежит в ChunkStore: воркер отвечает компактным результатом без копий предложений
+    bool compact = false;
+    // Хеш текста чанка (chunkHash) - ключ кэша результатов у воркеров; 0 - не посчитан
+    uint64_t hash = 0;
+    // Приоритет задачи 0..MAX_PRIORITY и арендатор, чья очередь (taskQueue) её несёт
+    uint8_t priority = 0;
+    std::string_view tenant;
+    // Какие анализы нужны задаче - битовая маска util::Analysis; 0 - все
+    uint32_t analyses = 0;
+    std::vector<std::string_view> sentences;
+
+    // Хранилище для строк, которые нельзя показать прямо из тела (JSON с экранированием)
+    std::vector<std::string> owned;
+};
+
+// Предложение чанка по номеру и его длина - элемент перестановки "по убыванию длины"
+struct SentenceRef {
+    uint32_t index = 0;
+    uint32_t length = 0;
+};
+
+// Замена имени: байты [offset, offset + length) предложения sentence заменяются на replacement
+struct NameEdit {
+    uint32_t sentence = 0;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+struct ResultMessage {
+    uint64_t id = 0;
+    uint64_t chunk = 0;
+    uint64_t total = 0;
+    // Отправка чанка сплиттером, начало и конец обработки воркером
+    uint64_t sent_us = 0;
+    uint64_t started_us = 0;
+    uint64_t finished_us = 0;
+    // Результат взят из кэша воркера, а не посчитан заново
+    bool cached = false;
+    // Копируются из задачи: агрегатору нужны для прогресса и перезапроса чанков
+    uint8_t priority = 0;
+    std::string_view tenant;
+    // Маска анализов задачи: агрегатор не выводит то, что не считалось
+    uint32_t analyses = 0;
+    uint64_t word_count = 0;
+    // Полная таблица частот чанка (слово -> количество), из неё агрегатор считает точный top-N
+    std::vector<std::pair<std::string_view, size_t>> word_frequencies;
+    size_t positive = 0;
+    size_t negative = 0;
+    int64_t score = 0;
+    std::vector<std::string_view> sorted_sentences;
+    std::vector<std::string_view> sentences_with_replaced_names;
+
+    // Компактный результат: вместо двух копий текста - перестановка и правки относительно исходного чанка
+    bool compact = false;
+    std::vector<SentenceRef> sorted_order;
+    std::vector<NameEdit> name_edits;
+    std::string_view replacement;
+
+    std::vector<std::string> owned;
+};
+
+// Воркер -> сплиттер: сколько байт предложений в чанке и сколько длилась его обработка
+struct FeedbackMessage {
+    uint64_t id = 0;
+    uint64_t chunk = 0;
+    uint64_t bytes = 0;
+    uint64_t processing_us = 0;
+};
+
+// Отзывы задачи идут в её собственную очередь chunk_feedback.<id>: сплиттеры параллельных задач не отбирают
+// друг у друга отзывы, а после выхода сплиттера очередь удаляется брокером вместе с опоздавшими отзывами
+std::string feedbackQueue(uint64_t job_id);
+
+// Задачи арендатора идут в task_queue.<tenant>, без арендатора - в прежнюю task_queue. Очереди объявляются
+// с x-max-priority = MAX_PRIORITY, брокер отдаёт сообщения с большим приоритетом раньше.
+inline constexpr uint8_t MAX_PRIORITY = 9;
+std::string taskQueue(std::string_view tenant);
+
+std::string encode(const TaskMessage &message, Format format);
+std::string encode(const ResultMessage &message, Format format);
+std::string encode(const FeedbackMessage &message, Format format);
+TaskMessage decodeTask(std::string_view body, Format format);
+ResultMessage decodeResult(std::string_view body, Format format);
+FeedbackMessage decodeFeedback(std::string_view body, Format format);
+
+// Пачка уже закодированных результатов одним сообщением (в JSON - массив объектов)
+std::string encodeBatch(const std::vector<std::string> &results, Format format);
+// Принимает и одиночный результат, и пачку
+std::vector<ResultMessage> decodeResults(std::string_view body, Format format);
+
+// Агрегаторы можно шардировать по id задачи: все результаты задачи попадают в одну очередь
+// agg_queue.<shard>, при одном шарде - в прежнюю agg_queue
+size_t shardOf(uint64_t job_id, size_t shards);
+std::string resultQueue(size_t shard, size_t shards);
+
+std::vector<std::string_view> toViews(const std::vector<std::string> &strings);
+
+} // namespace util::wire
+
+#endif //PARL_LAB2_WIRE_FORMAT_HPP
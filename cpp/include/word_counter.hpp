@@ -0,0 +1,89 @@
+#ifndef PARL_LAB2_WORD_COUNTER_HPP
+#define PARL_LAB2_WORD_COUNTER_HPP
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+// Счётчик слов на открытой адресации (линейное пробирование). Ключи хранятся подряд в одном
+// буфере-арене, в слоте только хеш, смещение и длина, поэтому поиск - один проход по массиву
+// без обхода указателей, а искать можно прямо по string_view.
+class WordCounter {
+public:
+    using value_type = std::pair<std::string_view, size_t>;
+
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = WordCounter::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+        Iterator(const WordCounter *counter, size_t index) : counter(counter), index(index) { skipEmpty(); }
+
+        value_type operator*() const { return counter->entry(index); }
+        Iterator &operator++()
+        {
+            ++index;
+            skipEmpty();
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            Iterator copy = *this;
+            ++*this;
+            return copy;
+        }
+        bool operator==(const Iterator &other) const { return index == other.index; }
+
+    private:
+        void skipEmpty()
+        {
+            while (index < counter->slots.size() && counter->slots[index].count == 0) {
+                ++index;
+            }
+        }
+
+        const WordCounter *counter = nullptr;
+        size_t index = 0;
+    };
+
+    WordCounter() = default;
+
+    void add(std::string_view word, size_t count = 1);
+    void merge(const WordCounter &other);
+    [[nodiscard]] size_t count(std::string_view word) const;
+    [[nodiscard]] size_t size() const { return used; }
+    [[nodiscard]] bool empty() const { return used == 0; }
+    void clear();
+
+    [[nodiscard]] Iterator begin() const { return {this, 0}; }
+    [[nodiscard]] Iterator end() const { return {this, slots.size()}; }
+
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        size_t count = 0; // 0 - пустой слот
+    };
+
+    [[nodiscard]] size_t findSlot(std::string_view word, uint64_t hash) const;
+    [[nodiscard]] value_type entry(size_t index) const;
+    void grow();
+
+    std::vector<Slot> slots;
+    std::string keys;
+    size_t used = 0;
+};
+
+} // namespace util
+
+#endif //PARL_LAB2_WORD_COUNTER_HPP
@@ -4,19 +4,192 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <span>
 #include <sstream>
 #include <set>
+#include <type_traits>
+
+#include "word_counter.hpp"
+#include "name_scanner.hpp"
+#include "sentence_store.hpp"
+#include "sentiment_lexicon.hpp"
+#include "tokenizer.hpp"
 
 namespace util {
 
+// Полная таблица частот слов чанка. Таблицы складываются без потерь, поэтому top-N после слияния точный
+using WordCounts = WordCounter;
+
+// Анализы, которые может запросить задача (TaskMessage::analyses). Пословные считаются одним проходом
+// analyzeChunk, имена и сортировка - отдельно над целыми предложениями.
+enum Analysis : unsigned {
+    WORD_COUNT = 1u << 0,
+    WORD_FREQUENCIES = 1u << 1,
+    SENTIMENT = 1u << 2,
+    NAMES = 1u << 3,
+    SORT = 1u << 4,
+    WORD_ANALYSES = WORD_COUNT | WORD_FREQUENCIES | SENTIMENT,
+    ALL_ANALYSES = WORD_ANALYSES | NAMES | SORT,
+};
+
+// "words,frequencies,sentiment,names,sort" или "all" -> маска Analysis
+unsigned parseAnalyses(std::string_view spec);
+
+struct ChunkAnalysis {
+    size_t word_count = 0;
+    WordCounts word_frequencies;
+    size_t positive = 0;
+    size_t negative = 0;
+};
+
+// Реестр стадий пословного прохода. Стадия - тип без состояния с битом FLAG и одним или двумя хуками:
+//   sentence(words, result) - раз на предложение с числом слов в нём;
+//   word(word, result)      - на каждое слово; LOWER - нужно ли слово в нижнем регистре.
+struct WordCountStage {
+    static constexpr unsigned FLAG = WORD_COUNT;
+    static constexpr bool LOWER = false;
+    static void sentence(size_t words, ChunkAnalysis &result) { result.word_count += words; }
+};
+
+struct WordFrequencyStage {
+    static constexpr unsigned FLAG = WORD_FREQUENCIES;
+    static constexpr bool LOWER = true;
+    static void word(std::string_view word, ChunkAnalysis &result) { result.word_frequencies.add(word); }
+};
+
+struct SentimentStage {
+    static constexpr unsigned FLAG = SENTIMENT;
+    static constexpr bool LOWER = true;
+    static void word(std::string_view word, ChunkAnalysis &result)
+    {
+        int polarity = lexicon::SENTIMENT.polarity(word);
+        result.positive += polarity > 0;
+        result.negative += polarity < 0;
+    }
+};
+
+template <typename... Stages>
+struct StageList {};
+
+// Новая стадия дописывается сюда и получает следующий бит: маски WORD_ANALYSES идут подряд с нулевого
+using WordStages = StageList<WordCountStage, WordFrequencyStage, SentimentStage>;
+
+template <typename Stage>
+concept SentenceHook = requires(ChunkAnalysis &result) { Stage::sentence(size_t{}, result); };
+template <typename Stage>
+concept WordHook = requires(ChunkAnalysis &result) { Stage::word(std::string_view{}, result); };
+
+// Проход, специализированный под набор стадий при компиляции: токенизация одна на всех, нижний регистр
+// и цикл по словам - только если они нужны хоть одной стадии, хуки встраиваются в цикл без ветвлений по маске
+template <typename... Stages>
+struct AnalysisPipeline {
+    static constexpr unsigned MASK = (0u | ... | Stages::FLAG);
+    static constexpr bool LOWER = (false || ... || Stages::LOWER);
+    static constexpr bool PER_WORD = (false || ... || WordHook<Stages>);
+
+    template <typename Sentences>
+    static void run(const Sentences &sentences, ChunkAnalysis &result)
+    {
+        if constexpr (LOWER) {
+            LowerArena arena;
+            for (std::string_view sentence : sentences) {
+                arena.tokenize(sentence);
+                visit(arena.words(), [&](Token token) { return arena.word(token); }, result);
+            }
+        } else if constexpr (sizeof...(Stages) != 0) {
+            std::vector<Token> tokens;
+            for (std::string_view sentence : sentences) {
+                tokens.clear();
+                tokenize(sentence, tokens);
+                visit(tokens, [&](Token token) { return sentence.substr(token.offset, token.length); }, result);
+            }
+        }
+    }
+
+private:
+    template <typename WordOf>
+    static void visit(const std::vector<Token> &tokens, WordOf word_of, ChunkAnalysis &result)
+    {
+        (sentenceHook<Stages>(tokens.size(), result), ...);
+        if constexpr (PER_WORD) {
+            for (auto token : tokens) {
+                auto word = word_of(token);
+                (wordHook<Stages>(word, result), ...);
+            }
+        }
+    }
+
+    template <typename Stage>
+    static void sentenceHook(size_t words, ChunkAnalysis &result)
+    {
+        if constexpr (SentenceHook<Stage>) {
+            Stage::sentence(words, result);
+        }
+    }
+
+    template <typename Stage>
+    static void wordHook(std::string_view word, ChunkAnalysis &result)
+    {
+        if constexpr (WordHook<Stage>) {
+            Stage::word(word, result);
+        }
+    }
+};
+
+// Конвейер из стадий реестра, чьи биты есть в Mask
+template <unsigned Mask, typename Selected, typename... Rest>
+struct SelectStages;
+
+template <unsigned Mask, typename... Selected>
+struct SelectStages<Mask, StageList<Selected...>> {
+    using type = AnalysisPipeline<Selected...>;
+};
+
+template <unsigned Mask, typename... Selected, typename Next, typename... Rest>
+struct SelectStages<Mask, StageList<Selected...>, Next, Rest...> {
+    using type = typename SelectStages<
+            Mask, std::conditional_t<(Mask & Next::FLAG) != 0, StageList<Selected..., Next>, StageList<Selected...>>,
+            Rest...>::type;
+};
+
+template <unsigned Mask, typename Registry = WordStages>
+struct PipelineFor;
+
+template <unsigned Mask, typename... Stages>
+struct PipelineFor<Mask, StageList<Stages...>> {
+    using type = typename SelectStages<Mask, StageList<>, Stages...>::type;
+};
+
+// Один проход по тексту: маска выбирает одну из 2^N заранее собранных специализаций AnalysisPipeline
+ChunkAnalysis analyzeChunk(std::span<const std::string_view> sentences, unsigned analyses);
+ChunkAnalysis analyzeChunk(const std::vector<std::string> &sentences, unsigned analyses);
+
 std::pair<size_t, size_t> analyzeSentiment(const std::vector<std::string> &sentences);
-std::vector<std::string> splitIntoWords(const std::string &text);
+std::vector<std::string> splitIntoWords(std::string_view text);
+WordCounts countWords(const std::vector<std::string> &sentences);
+void mergeWordCounts(WordCounts &into, const std::vector<std::pair<std::string, size_t>> &counts);
+std::vector<std::pair<std::string, size_t>> topN(const WordCounts &counts, size_t n);
 std::vector<std::pair<std::string, size_t>> topNWords(const std::vector<std::string> &sentences, size_t n);
 std::vector<std::string> sortSentencesByLength(const std::vector<std::string> &sentences);
 std::vector<std::string> replaceNames(const std::vector<std::string> &sentences, const std::string &replacement);
+std::vector<std::string> replaceNames(const std::vector<std::string> &sentences, const std::string &replacement,
+                                      const NameRules &rules);
 std::vector<std::pair<std::string, size_t>> mergeTopWords(
         const std::vector<std::vector<std::pair<std::string, size_t>>> &all_top_words, size_t n);
 
+// Перегрузки над view: предложения не копируются, результат - номера, view в исходные строки
+// или SentenceStore, т.е. несколько выделений памяти на чанк вместо одного на предложение
+std::pair<size_t, size_t> analyzeSentiment(std::span<const std::string_view> sentences);
+WordCounts countWords(std::span<const std::string_view> sentences);
+std::vector<std::pair<std::string, size_t>> topNWords(std::span<const std::string_view> sentences, size_t n);
+// Номера предложений по убыванию длины, равные по длине - в исходном порядке
+std::vector<uint32_t> sortedIndicesByLength(std::span<const std::string_view> sentences);
+std::vector<std::string_view> sortSentencesByLength(std::span<const std::string_view> sentences);
+void replaceNames(std::span<const std::string_view> sentences, std::string_view replacement, const NameRules &rules,
+                  SentenceStore &out);
+
+// Слияние чанков, каждый из которых уже отсортирован по убыванию длины
 std::vector<std::string> mergeAndSortSentences(const std::vector<std::vector<std::string>> &all_sentences);
 
 
@@ -0,0 +1,711 @@
+#include "stages.hpp"
+#include "chunk_store.hpp"
+#include "config.hpp"
+#include "metrics.hpp"
+#include "run_store.hpp"
+#include "thread_pool.hpp"
+#include "words_util.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <set>
+#include <vector>
+
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <nlohmann/json.hpp>
+
+namespace util {
+namespace {
+// Полученные чанки задачи, бит на чанк
+class ChunkBitmap {
+public:
+    // false - чанк уже был получен
+    bool insert(uint64_t chunk)
+    {
+        size_t word = chunk / 64;
+        if (word >= words.size()) {
+            words.resize(word + 1, 0);
+        }
+        uint64_t bit = uint64_t{1} << (chunk % 64);
+        if ((words[word] & bit) != 0) {
+            return false;
+        }
+        words[word] |= bit;
+        ++count;
+        return true;
+    }
+
+    [[nodiscard]] size_t size() const { return count; }
+
+    // Не полученные чанки из [0, total)
+    [[nodiscard]] std::vector<uint64_t> missing(uint64_t total) const
+    {
+        std::vector<uint64_t> result;
+        for (uint64_t word = 0; word * 64 < total; ++word) {
+            uint64_t absent = ~(word < words.size() ? words[word] : 0);
+            for (; absent != 0; absent &= absent - 1) {
+                uint64_t chunk = word * 64 + std::countr_zero(absent);
+                if (chunk >= total) {
+                    break;
+                }
+                result.push_back(chunk);
+            }
+        }
+        return result;
+    }
+
+private:
+    std::vector<uint64_t> words;
+    size_t count = 0;
+};
+
+// Состояние задачи сворачивается по мере прихода чанков: счётчики и частоты слов складываются сразу,
+// а отсортированные предложения лежат прогонами в RunStore и сливаются только при выдаче.
+// Компактные результаты хранят только перестановку и правки, текст при выдаче читается из ChunkStore.
+struct JobState {
+    struct CompactChunk {
+        std::vector<wire::SentenceRef> order;
+        std::vector<wire::NameEdit> edits;
+    };
+
+    // Лимит задачи делится поровну: отсортированные и заменённые предложения примерно одного объёма
+    JobState(const std::string &spill_dir, size_t memory_limit)
+        : sorted_sentences(RunStore::Order::ByLength, spill_dir, memory_limit / 2),
+          replaced_sentences(RunStore::Order::ByRunId, spill_dir, memory_limit / 2)
+    {
+    }
+
+    uint64_t total_chunks = 0;
+    ChunkBitmap received;
+    std::vector<uint64_t> word_counts;
+    uint64_t total_words = 0;
+    uint64_t sentences = 0;
+    WordCounter word_frequencies;
+    size_t positive = 0;
+    size_t negative = 0;
+    int64_t sentiment = 0;
+    RunStore sorted_sentences;
+    RunStore replaced_sentences;
+    bool compact = false;
+    std::map<uint64_t, CompactChunk> compact_chunks;
+    std::string replacement;
+    // Из первого результата: чья задача, с каким приоритетом и какими анализами; labels - метки для метрик
+    std::string tenant;
+    uint8_t priority = 0;
+    unsigned analyses = ALL_ANALYSES;
+    std::string labels;
+    std::chrono::steady_clock::time_point opened;
+    // Срок следующего чанка сдвигается с каждым новым; timer - таймер транспорта, retries - перезапросы
+    std::chrono::steady_clock::time_point deadline;
+    uint64_t timer = 0;
+    size_t retries = 0;
+    bool complete = true;
+    std::vector<uint64_t> missing_chunks;
+};
+
+// k-way слияние перестановок чанков по убыванию длины; текст читается по одному предложению
+void forEachSorted(const JobState &job, ChunkReader &reader, const RunStore::Callback &callback)
+{
+    struct Cursor {
+        uint64_t chunk;
+        const std::vector<wire::SentenceRef> *order;
+        size_t pos;
+    };
+    auto later = [](const Cursor &a, const Cursor &b) {
+        auto x = (*a.order)[a.pos].length;
+        auto y = (*b.order)[b.pos].length;
+        return x != y ? x < y : a.chunk > b.chunk;
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heap(later);
+    for (const auto &[chunk, data] : job.compact_chunks) {
+        if (!data.order.empty()) {
+            heap.push({chunk, &data.order, 0});
+        }
+    }
+
+    while (!heap.empty()) {
+        auto cursor = heap.top();
+        heap.pop();
+        if (!callback(reader.sentence(cursor.chunk, (*cursor.order)[cursor.pos].index))) {
+            return;
+        }
+        if (++cursor.pos < cursor.order->size()) {
+            heap.push(cursor);
+        }
+    }
+}
+
+// Чанки по порядку, к исходному тексту применяются правки
+void forEachReplaced(const JobState &job, ChunkReader &reader, const RunStore::Callback &callback)
+{
+    std::string out;
+    for (const auto &[chunk, data] : job.compact_chunks) {
+        auto sentences = reader.sentences(chunk);
+        auto edit = data.edits.begin();
+        for (size_t i = 0; i < sentences.size(); ++i) {
+            std::string_view sentence = sentences[i];
+            out.clear();
+            size_t copied = 0;
+            for (; edit != data.edits.end() && edit->sentence == i; ++edit) {
+                out.append(sentence.substr(copied, edit->offset - copied));
+                out.append(job.replacement);
+                copied = edit->offset + edit->length;
+            }
+            out.append(sentence.substr(copied));
+            if (!callback(out)) {
+                return;
+            }
+        }
+    }
+}
+
+struct AggregatorMetrics {
+    Histogram &decompress =
+        Metrics::global().histogram("lab2_aggregator_decompress_seconds", "Decompression of a result message");
+    Histogram &decode = Metrics::global().histogram("lab2_aggregator_decode_seconds", "Decoding of a result message");
+    Histogram &fold = Metrics::global().histogram("lab2_aggregator_fold_seconds", "Folding one result into its job");
+    Histogram &finalize = Metrics::global().histogram("lab2_aggregator_finalize_seconds", "Finalization of a job");
+    Histogram &top_n = Metrics::global().histogram("lab2_aggregator_top_n_seconds", "Selection of the top words");
+    Histogram &merge = Metrics::global().histogram("lab2_aggregator_merge_seconds", "Merge of sorted sentence runs");
+    Histogram &queue_wait =
+        Metrics::global().histogram("lab2_chunk_queue_wait_seconds", "From splitter publish to worker start");
+    Histogram &processing = Metrics::global().histogram("lab2_chunk_processing_seconds", "Processing in the worker");
+    Histogram &result_transit =
+        Metrics::global().histogram("lab2_chunk_result_transit_seconds", "From worker finish to aggregator receipt");
+    Histogram &end_to_end =
+        Metrics::global().histogram("lab2_chunk_end_to_end_seconds", "From splitter publish to aggregator receipt");
+    GaugeFamily &chunks_received = Metrics::global().gauges("lab2_job_chunks_received", "Folded chunks of open jobs");
+    GaugeFamily &chunks_total =
+        Metrics::global().gauges("lab2_job_chunks_total", "Chunks in open jobs, 0 while the total is unknown");
+    Counter &results = Metrics::global().counter("lab2_aggregator_results_total", "Received chunk results");
+    Counter &bytes_in = Metrics::global().counter("lab2_aggregator_bytes_in_total", "Result bytes received");
+    Counter &cached = Metrics::global().counter("lab2_aggregator_cached_results_total", "Results served from a cache");
+    Counter &duplicates =
+        Metrics::global().counter("lab2_aggregator_duplicate_results_total", "Results for chunks already received");
+    Counter &redelivered =
+        Metrics::global().counter("lab2_aggregator_redelivered_total", "Result messages redelivered by the broker");
+    Counter &rerequested =
+        Metrics::global().counter("lab2_aggregator_rerequested_chunks_total", "Chunks re-requested after a timeout");
+    Counter &timed_out =
+        Metrics::global().counter("lab2_aggregator_timed_out_jobs_total", "Jobs closed incomplete after a timeout");
+};
+
+AggregatorMetrics &metrics()
+{
+    static AggregatorMetrics metrics;
+    return metrics;
+}
+
+// Задержки этапов по чанкам, в микросекундах; пишутся только из потока цикла. Гистограммы метрик
+// ограничены по памяти, а сырые выборки для точных перцентилей отчёта копятся, только если он нужен.
+struct StageLatencies {
+    bool keep_samples = false;
+    std::vector<uint64_t> queue_wait;     // сплиттер -> начало обработки воркером
+    std::vector<uint64_t> processing;     // обработка чанка воркером
+    std::vector<uint64_t> result_transit; // конец обработки -> приём агрегатором
+    std::vector<uint64_t> end_to_end;     // сплиттер -> приём агрегатором
+
+    void record(const wire::ResultMessage &result, uint64_t received_us)
+    {
+        // Старые отправители не ставят метки
+        if (result.sent_us == 0 || result.started_us == 0) {
+            return;
+        }
+        auto since = [](uint64_t from, uint64_t to) { return to > from ? to - from : 0; };
+        uint64_t wait = since(result.sent_us, result.started_us);
+        uint64_t work = since(result.started_us, result.finished_us);
+        uint64_t transit = since(result.finished_us, received_us);
+        uint64_t total = since(result.sent_us, received_us);
+        metrics().queue_wait.record(wait);
+        metrics().processing.record(work);
+        metrics().result_transit.record(transit);
+        metrics().end_to_end.record(total);
+        if (keep_samples) {
+            queue_wait.push_back(wait);
+            processing.push_back(work);
+            result_transit.push_back(transit);
+            end_to_end.push_back(total);
+        }
+    }
+};
+
+nlohmann::json percentiles(std::vector<uint64_t> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double p) {
+        return samples.empty() ? 0 : samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+    };
+    return {{"count", samples.size()}, {"p50", at(0.5)}, {"p90", at(0.9)}, {"p99", at(0.99)}, {"max", at(1.0)}};
+}
+
+// Машиночитаемый отчёт для бенчмарка: задачи и перцентили задержек этапов
+void writeReport(const std::string &path, const std::vector<JobSummary> &jobs, const StageLatencies &latencies)
+{
+    nlohmann::json report;
+    report["jobs"] = nlohmann::json::array();
+    for (const auto &job : jobs) {
+        report["jobs"].push_back({{"id", job.id},
+                                  {"chunks", job.total_chunks},
+                                  {"sentences", job.sentences},
+                                  {"words", job.total_words},
+                                  {"duration_ms", job.duration_ms}});
+    }
+    report["latency_us"] = {{"queue_wait", percentiles(latencies.queue_wait)},
+                            {"processing", percentiles(latencies.processing)},
+                            {"result_transit", percentiles(latencies.result_transit)},
+                            {"end_to_end", percentiles(latencies.end_to_end)}};
+
+    std::ofstream out(path);
+    out << report.dump(2) << '\n';
+    if (!out) {
+        fmt::println("Cannot write report to {}", path);
+    }
+}
+
+std::string preview(std::string_view sentence)
+{
+    return std::string(sentence.substr(0, 100)) + (sentence.length() > 100 ? "..." : "");
+}
+
+// Отдаёт в sink все предложения по ходу слияния; без sink слияние останавливается после превью первых limit
+using SentenceSource = std::function<void(const RunStore::Callback &)>;
+
+void emit(const SentenceSource &source, ResultSink *sink, void (ResultSink::*write)(std::string_view),
+          size_t limit, const std::function<void(size_t, std::string_view)> &print)
+{
+    ScopedTimer timer(metrics().merge);
+    size_t index = 0;
+    source([&](std::string_view sentence) {
+        if (index < limit) {
+            print(index, sentence);
+        }
+        ++index;
+        if (sink != nullptr) {
+            (sink->*write)(sentence);
+            return true;
+        }
+        return index < limit;
+    });
+}
+
+// Итог задачи собирается в строку и печатается целиком: финализации разных задач идут параллельно
+std::string finalize(uint64_t id, const JobState &result, const AggregatorOptions &options, JobSummary &summary)
+{
+    ScopedTimer timer(metrics().finalize);
+    std::vector<std::pair<std::string, size_t>> top_words;
+    {
+        ScopedTimer top_timer(metrics().top_n);
+        top_words = topN(result.word_frequencies, options.top_n);
+    }
+    summary = JobSummary{
+        .id = id,
+        .total_chunks = result.total_chunks,
+        .word_counts = result.word_counts,
+        .total_words = result.total_words,
+        .sentences = result.sentences,
+        .positive = result.positive,
+        .negative = result.negative,
+        .sentiment = result.sentiment,
+        .top_words = std::move(top_words),
+        .duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                               .count() -
+                           static_cast<int64_t>(id),
+        .complete = result.complete,
+        .missing_chunks = result.missing_chunks,
+    };
+
+    std::string report;
+    auto out = std::back_inserter(report);
+    fmt::format_to(out, "\n=== AGGREGATED RESULT ===\n");
+    fmt::format_to(out, "Task ID: {}\n", id);
+    fmt::format_to(out, "Total chunks: {}\n", summary.total_chunks);
+    if (!summary.complete) {
+        size_t shown = std::min<size_t>(summary.missing_chunks.size(), 20);
+        fmt::format_to(out, "INCOMPLETE: timed out, {} chunks missing: {}{}\n", summary.missing_chunks.size(),
+                       fmt::join(summary.missing_chunks.begin(), summary.missing_chunks.begin() + shown, ", "),
+                       shown < summary.missing_chunks.size() ? ", ..." : "");
+    }
+    fmt::format_to(out, "Word counts per chunk: {}\n", summary.word_counts);
+    fmt::format_to(out, "TOTAL WORDS: {}\n", summary.total_words);
+    fmt::format_to(out, "DURATION IS: {}\n", summary.duration_ms);
+
+    // Разделы анализов, которые задача не запрашивала, не печатаются
+    if (result.analyses & SENTIMENT) {
+        fmt::format_to(out, "\nSENTIMENT ANALYSIS:\n");
+        fmt::format_to(out, "Positive words: {}\n", summary.positive);
+        fmt::format_to(out, "Negative words: {}\n", summary.negative);
+        fmt::format_to(out, "Overall sentiment score: {:+}\n", summary.sentiment);
+        fmt::format_to(out, "Sentiment: {}\n", summary.sentiment > 0   ? "POSITIVE"
+                                               : summary.sentiment < 0 ? "NEGATIVE"
+                                                                       : "NEUTRAL");
+    }
+
+    if (result.analyses & WORD_FREQUENCIES) {
+        fmt::format_to(out, "\nTOP {} WORDS:\n", options.top_n);
+        for (size_t i = 0; i < summary.top_words.size(); ++i) {
+            const auto &[word, count] = summary.top_words[i];
+            fmt::format_to(out, "  {}. {}: {}\n", i + 1, word, count);
+        }
+    }
+
+    std::optional<ChunkReader> reader;
+    if (result.compact) {
+        if (options.chunk_store.empty()) {
+            throw std::runtime_error("finalize: compact results need LAB2_CHUNK_STORE");
+        }
+        reader.emplace(options.chunk_store, id);
+    }
+    SentenceSource sorted = [&](const RunStore::Callback &callback) {
+        reader ? forEachSorted(result, *reader, callback) : result.sorted_sentences.forEach(callback);
+    };
+    SentenceSource replaced = [&](const RunStore::Callback &callback) {
+        reader ? forEachReplaced(result, *reader, callback) : result.replaced_sentences.forEach(callback);
+    };
+
+    auto sink = ResultSink::open(options.sink_format, options.output_dir, id);
+    if (sink) {
+        sink->summary(summary);
+    }
+
+    if (result.analyses & SORT) {
+        fmt::format_to(out, "\nLONGEST 5 SENTENCES:\n");
+        emit(sorted, sink.get(), &ResultSink::sorted, 5, [&](size_t i, std::string_view sentence) {
+            fmt::format_to(out, "  {}. {} chars: {}\n", i + 1, sentence.length(), preview(sentence));
+        });
+    }
+
+    if (result.analyses & NAMES) {
+        fmt::format_to(out, "\nEXAMPLES WITH NAMES REPLACED:\n");
+        emit(replaced, sink.get(), &ResultSink::replaced, 3, [&](size_t i, std::string_view sentence) {
+            fmt::format_to(out, "  {}. {}\n", i + 1, preview(sentence));
+        });
+    }
+
+    size_t spilled = result.sorted_sentences.spilledBytes() + result.replaced_sentences.spilledBytes();
+    if (spilled != 0) {
+        fmt::format_to(out, "\nSpilled to disk: {:.1f} MB\n", spilled / 1e6);
+    }
+    if (sink) {
+        sink->close();
+        fmt::format_to(out, "\nFull result written to {}\n", sink->path());
+    }
+    if (reader) {
+        // Тексты чанков нужны только до выдачи результата
+        std::filesystem::remove(ChunkReader::pathOf(options.chunk_store, id));
+    }
+    fmt::format_to(out, "=========================\n");
+    return report;
+}
+}
+
+AggregatorOptions AggregatorOptions::fromEnv()
+{
+    AggregatorOptions options;
+    options.top_n = envSize("LAB2_TOP_N", options.top_n);
+    options.memory_limit = envSize("LAB2_AGG_MEMORY_MB", options.memory_limit >> 20) << 20;
+    options.spill_dir = envString("LAB2_SPILL_DIR", std::filesystem::temp_directory_path().string());
+    // Полный результат каждой задачи уходит в LAB2_OUTPUT_DIR в формате LAB2_SINK (по умолчанию не пишется)
+    options.sink_format = ResultSink::formatFromEnv();
+    options.output_dir = envString("LAB2_OUTPUT_DIR", options.output_dir);
+    options.chunk_store = envString("LAB2_CHUNK_STORE", "");
+    options.shards = std::max<size_t>(1, envSize("LAB2_AGG_SHARDS", options.shards));
+    options.shard = envSize("LAB2_AGG_SHARD", options.shard);
+    options.threads = envSize("LAB2_AGG_THREADS", options.threads);
+    options.job_timeout = envDouble("LAB2_JOB_TIMEOUT_S", options.job_timeout);
+    options.job_retries = envSize("LAB2_JOB_RETRIES", options.job_retries);
+    options.progress_interval = envDouble("LAB2_PROGRESS_S", options.progress_interval);
+    options.exit_after = envSize("LAB2_EXIT_AFTER_JOBS", options.exit_after);
+    options.report_path = envString("LAB2_REPORT", "");
+    options.compression = CompressionOptions::fromEnv();
+    return options;
+}
+
+int runAggregator(Transport &transport, const AggregatorOptions &options)
+{
+    if (options.shard >= options.shards) {
+        fmt::println("Shard {} is out of range for {} shards", options.shard, options.shards);
+        return 1;
+    }
+    std::string queue = wire::resultQueue(options.shard, options.shards);
+
+    std::map<uint64_t, std::unique_ptr<JobState>> results;
+    // payload - под разжатое тело: декодированные результаты ссылаются в него до конца колбэка consume
+    PayloadCodec codec(options.compression);
+    std::string payload;
+    // Недавно закрытые задачи: запоздавший повтор их чанка не должен завести задачу заново
+    constexpr size_t CLOSED_JOBS = 4096;
+    std::set<uint64_t> closed;
+    std::deque<uint64_t> closed_order;
+    StageLatencies latencies{.keep_samples = !options.report_path.empty()};
+    std::mutex finished_mutex;
+    size_t finished_jobs = 0;
+    // Итоги задач хранятся только для отчёта
+    std::vector<JobSummary> finished;
+    // Поднимается перед transport.close(): периодические таймеры больше не заводятся
+    std::atomic<bool> closing{false};
+    // Объявлен после состояния, на которое ссылаются финализации: при выходе сначала дожидаемся их
+    ThreadPool pool(options.threads);
+
+    using Clock = std::chrono::steady_clock;
+    auto timeout = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.job_timeout));
+
+    transport.declareQueue(queue,
+                           [queue] { fmt::println("Aggregator started. Waiting for results in queue '{}'", queue); });
+
+    // Слияние большой задачи не должно задерживать приём результатов остальных
+    auto finish = [&](uint64_t id) {
+        auto it = results.find(id);
+        std::shared_ptr<JobState> job = std::move(it->second);
+        results.erase(it);
+        if (job->timer != 0) {
+            transport.stopTimer(job->timer);
+        }
+        metrics().chunks_received.erase(job->labels);
+        metrics().chunks_total.erase(job->labels);
+        closed.insert(id);
+        closed_order.push_back(id);
+        if (closed_order.size() > CLOSED_JOBS) {
+            closed.erase(closed_order.front());
+            closed_order.pop_front();
+        }
+
+        pool.submit([&, id, job] {
+            JobSummary summary;
+            try {
+                fmt::print("{}\n", finalize(id, *job, options, summary));
+            } catch (const std::exception &error) {
+                fmt::println("Failed to finalize job {}: {}", id, error.what());
+            }
+
+            std::lock_guard lock(finished_mutex);
+            if (!options.report_path.empty()) {
+                finished.push_back(std::move(summary));
+            }
+            if (options.exit_after != 0 && ++finished_jobs == options.exit_after) {
+                closing.store(true);
+                transport.close();
+            }
+        });
+    };
+
+    // Недостающие чанки компактной задачи снова уходят воркерам: их текст остался в ChunkStore
+    auto rerequest = [&](uint64_t id, const JobState &job, uint64_t total, ChunkReader &reader,
+                         const std::vector<uint64_t> &missing) {
+        auto content_type = wire::contentType(wire::Format::Binary);
+        auto task_queue = wire::taskQueue(job.tenant);
+        transport.declareQueue(task_queue, {}, wire::MAX_PRIORITY);
+        for (uint64_t chunk : missing) {
+            auto sentences = reader.sentences(chunk);
+            auto body = wire::encode(wire::TaskMessage{.id = id,
+                                                       .chunk = chunk,
+                                                       .total = total,
+                                                       .sent_us = wire::nowMicros(),
+                                                       .compact = true,
+                                                       .priority = job.priority,
+                                                       .tenant = job.tenant,
+                                                       .analyses = job.analyses,
+                                                       .sentences = sentences.views()},
+                                     wire::Format::Binary);
+            auto encoding = codec.compress(body);
+            transport.publish(task_queue, body, content_type, job.priority, encoding);
+        }
+        metrics().rerequested.add(missing.size());
+    };
+
+    std::function<void(uint64_t)> expire;
+    auto arm = [&](uint64_t id, JobState &job, Clock::duration delay) {
+        job.timer = transport.startTimer(std::chrono::duration<double>(delay).count(), [&expire, id] { expire(id); });
+    };
+
+    // Таймер не переставляется на каждом чанке: сработав до сдвинутого срока, он заводится на остаток
+    expire = [&](uint64_t id) {
+        auto it = results.find(id);
+        if (it == results.end()) {
+            return;
+        }
+        auto &job = *it->second;
+        job.timer = 0;
+        auto now = Clock::now();
+        if (now < job.deadline) {
+            arm(id, job, job.deadline - now);
+            return;
+        }
+
+        std::optional<ChunkReader> reader;
+        if (job.compact && !options.chunk_store.empty()) {
+            try {
+                reader.emplace(options.chunk_store, id);
+            } catch (const std::exception &error) {
+                fmt::println("Job {}: cannot re-request chunks: {}", id, error.what());
+            }
+        }
+        // Пропал последний чанк - число чанков знает только ChunkStore: сплиттер, молчащий весь таймаут,
+        // уже записал их все
+        uint64_t total = job.total_chunks;
+        if (total == 0) {
+            total = reader ? reader->chunkCount() : job.word_counts.size();
+        }
+        auto missing = job.received.missing(total);
+
+        if (reader && !missing.empty() && job.retries < options.job_retries) {
+            ++job.retries;
+            fmt::println("Job {}: no results for {:.0f}s, re-requesting {} chunks (attempt {}/{})", id,
+                         options.job_timeout, missing.size(), job.retries, options.job_retries);
+            rerequest(id, job, total, *reader, missing);
+            job.deadline = now + timeout;
+            arm(id, job, timeout);
+            return;
+        }
+
+        fmt::println("Job {}: no results for {:.0f}s, closing it incomplete with {} chunks missing{}", id,
+                     options.job_timeout, missing.size(), job.total_chunks == 0 ? " (total unknown)" : "");
+        metrics().timed_out.add();
+        job.complete = false;
+        job.missing_chunks = std::move(missing);
+        finish(id);
+    };
+
+    // Прогресс открытых задач: сколько чанков свёрнуто из скольких
+    std::function<void()> report_progress = [&] {
+        auto now = Clock::now();
+        for (const auto &[id, job] : results) {
+            auto received = job->received.size();
+            double seconds = std::chrono::duration<double>(now - job->opened).count();
+            if (job->total_chunks == 0) {
+                fmt::println("Progress: job {} [{}] priority {}: {}/? chunks, {:.1f}s", id,
+                             job->tenant.empty() ? "default" : job->tenant, job->priority, received, seconds);
+            } else {
+                fmt::println("Progress: job {} [{}] priority {}: {}/{} chunks ({:.0f}%), {:.1f}s", id,
+                             job->tenant.empty() ? "default" : job->tenant, job->priority, received,
+                             job->total_chunks, 100.0 * received / job->total_chunks, seconds);
+            }
+        }
+        if (!closing.load()) {
+            transport.startTimer(options.progress_interval, report_progress);
+        }
+    };
+    if (options.progress_interval > 0) {
+        transport.startTimer(options.progress_interval, report_progress);
+    }
+
+    transport.consume(queue, 0, [&](const Transport::Message &message) {
+        // Воркер может прислать несколько результатов одной пачкой
+        metrics().bytes_in.add(message.body.size());
+        if (message.redelivered) {
+            metrics().redelivered.add();
+        }
+        std::string_view body;
+        {
+            ScopedTimer timer(metrics().decompress);
+            body = codec.decompress(message.body, message.content_encoding, payload);
+        }
+        std::vector<wire::ResultMessage> batch;
+        {
+            ScopedTimer timer(metrics().decode);
+            batch = wire::decodeResults(body, wire::formatOf(message.content_type));
+        }
+
+        uint64_t received_us = wire::nowMicros();
+        for (const auto &data : batch) {
+            latencies.record(data, received_us);
+            uint64_t id = data.id;
+            uint64_t chunk_num = data.chunk;
+            uint64_t total_chunks = data.total;
+
+            metrics().results.add();
+            if (data.cached) {
+                metrics().cached.add();
+            }
+            if (verbose()) {
+                fmt::println("Received result for ID={}, chunk {}/{}: {} words, sentiment={:+}", id, chunk_num,
+                             total_chunks, data.word_count, data.score);
+            }
+            if (closed.contains(id)) {
+                metrics().duplicates.add();
+                continue;
+            }
+
+            auto &slot = results[id];
+            if (!slot) {
+                slot = std::make_unique<JobState>(options.spill_dir, options.memory_limit);
+                slot->tenant.assign(data.tenant);
+                slot->priority = data.priority;
+                slot->analyses = data.analyses != 0 ? data.analyses : ALL_ANALYSES;
+                slot->labels = fmt::format("job=\"{}\",tenant=\"{}\"", id, labelValue(data.tenant));
+                slot->opened = Clock::now();
+                if (options.job_timeout > 0) {
+                    arm(id, *slot, timeout);
+                }
+            }
+            auto &result = *slot;
+            // Сплиттер узнаёт число чанков только в конце разбора и присылает его в последнем чанке
+            if (total_chunks != 0) {
+                result.total_chunks = total_chunks;
+            }
+            // Счётчики складываются сразу, поэтому повторная доставка чанка не должна учитываться дважды
+            if (!result.received.insert(chunk_num)) {
+                metrics().duplicates.add();
+                continue;
+            }
+            result.deadline = Clock::now() + timeout;
+            if (chunk_num >= result.word_counts.size()) {
+                result.word_counts.resize(std::max<size_t>(chunk_num + 1, result.total_chunks), 0);
+            }
+
+            {
+                ScopedTimer timer(metrics().fold);
+                result.word_counts[chunk_num] = data.word_count;
+                result.total_words += data.word_count;
+                result.sentences += data.compact ? data.sorted_order.size() : data.sorted_sentences.size();
+                for (const auto &[word, count] : data.word_frequencies) {
+                    result.word_frequencies.add(word, count);
+                }
+                result.positive += data.positive;
+                result.negative += data.negative;
+                result.sentiment += data.score;
+                if (data.compact) {
+                    result.compact = true;
+                    result.replacement.assign(data.replacement);
+                    result.compact_chunks[chunk_num] = {data.sorted_order, data.name_edits};
+                } else {
+                    result.sorted_sentences.add(chunk_num,
+                                                {data.sorted_sentences.begin(), data.sorted_sentences.end()});
+                    result.replaced_sentences.add(chunk_num, {data.sentences_with_replaced_names.begin(),
+                                                              data.sentences_with_replaced_names.end()});
+                }
+            }
+
+            metrics().chunks_received.set(result.labels, static_cast<double>(result.received.size()));
+            metrics().chunks_total.set(result.labels, static_cast<double>(result.total_chunks));
+            if (result.total_chunks != 0 && result.received.size() == result.total_chunks) {
+                finish(id);
+            }
+        }
+
+        transport.ack(message.delivery_tag);
+    });
+
+    transport.run();
+
+    if (!options.report_path.empty()) {
+        std::lock_guard lock(finished_mutex);
+        writeReport(options.report_path, finished, latencies);
+    }
+    return 0;
+}
+
+} // namespace util
@@ -0,0 +1,157 @@
+#include "amqp_transport.hpp"
+
+namespace util {
+
+AmqpTransport::AmqpTransport(const std::string &host, uint16_t port)
+    : loop(ev_default_loop(0)), handler(loop),
+      connection(&handler, AMQP::Address(host, port, AMQP::Login("guest", "guest"), "/")), channel(&connection),
+      executor(loop)
+{
+}
+
+AmqpTransport::~AmqpTransport()
+{
+    for (auto &[id, timer] : timers) {
+        ev_timer_stop(loop, &timer->watcher);
+    }
+}
+
+void AmqpTransport::declareQueue(const std::string &name, std::function<void()> ready, uint8_t max_priority,
+                                 bool temporary)
+{
+    AMQP::Table arguments;
+    if (max_priority != 0) {
+        arguments.set("x-max-priority", static_cast<int32_t>(max_priority));
+    }
+    channel.declareQueue(name, temporary ? AMQP::exclusive | AMQP::autodelete : AMQP::durable, arguments)
+        .onSuccess([ready = std::move(ready)](const std::string &, uint32_t, uint32_t) {
+            if (ready) {
+                ready();
+            }
+        });
+}
+
+void AmqpTransport::consume(const std::string &queue, size_t prefetch, Consumer consumer)
+{
+    if (prefetch != 0) {
+        channel.setQos(static_cast<uint16_t>(std::min<size_t>(prefetch, UINT16_MAX)));
+    }
+    channel.consume(queue).onReceived(
+        [consumer = std::move(consumer)](const AMQP::Message &message, uint64_t delivery_tag, bool redelivered) {
+            consumer(Message{{message.body(), message.bodySize()},
+                             message.contentType(),
+                             message.contentEncoding(),
+                             delivery_tag,
+                             redelivered});
+        });
+}
+
+void AmqpTransport::ack(uint64_t delivery_tag, bool multiple)
+{
+    channel.ack(delivery_tag, multiple ? AMQP::multiple : 0);
+}
+
+void AmqpTransport::publish(const std::string &queue, std::string_view body, std::string_view content_type,
+                            uint8_t priority, std::string_view content_encoding)
+{
+    AMQP::Envelope envelope(body.data(), body.size());
+    envelope.setContentType(std::string(content_type));
+    if (!content_encoding.empty()) {
+        envelope.setContentEncoding(std::string(content_encoding));
+    }
+    if (priority != 0) {
+        envelope.setPriority(priority);
+    }
+    channel.publish("", queue, envelope);
+}
+
+void AmqpTransport::publishConfirmed(const std::string &queue, std::string_view body, std::string_view content_type,
+                                     std::function<void(Confirm)> confirmed, uint8_t priority,
+                                     std::string_view content_encoding)
+{
+    // Режим подтверждений включается на канале при первой надёжной публикации
+    if (!reliable) {
+        reliable = std::make_unique<AMQP::Reliable<>>(channel);
+    }
+
+    AMQP::Envelope envelope(body.data(), body.size());
+    envelope.setContentType(std::string(content_type));
+    if (!content_encoding.empty()) {
+        envelope.setContentEncoding(std::string(content_encoding));
+    }
+    envelope.setPersistent();
+    if (priority != 0) {
+        envelope.setPriority(priority);
+    }
+
+    auto shared = std::make_shared<std::function<void(Confirm)>>(std::move(confirmed));
+    reliable->publish("", queue, envelope)
+        .onAck([shared] { (*shared)(Confirm::Ack); })
+        .onNack([shared] { (*shared)(Confirm::Nack); })
+        .onLost([shared] { (*shared)(Confirm::Lost); });
+}
+
+uint64_t AmqpTransport::startTimer(double seconds, std::function<void()> callback)
+{
+    if (closing) {
+        return 0;
+    }
+    auto timer = std::make_unique<Timer>();
+    timer->owner = this;
+    timer->id = ++next_timer;
+    timer->callback = std::move(callback);
+    ev_timer_init(&timer->watcher, &AmqpTransport::onTimer, seconds, 0.0);
+    timer->watcher.data = timer.get();
+    ev_timer_start(loop, &timer->watcher);
+    timers.emplace(timer->id, std::move(timer));
+    return next_timer;
+}
+
+void AmqpTransport::stopTimer(uint64_t id)
+{
+    auto it = timers.find(id);
+    if (it != timers.end()) {
+        ev_timer_stop(loop, &it->second->watcher);
+        timers.erase(it);
+    }
+}
+
+void AmqpTransport::onTimer(struct ev_loop *, ev_timer *watcher, int)
+{
+    auto *timer = static_cast<Timer *>(watcher->data);
+    auto *owner = timer->owner;
+    auto callback = std::move(timer->callback);
+    // Одноразовый таймер уже остановлен libev, освобождаем до колбэка: тот может завести новый
+    owner->timers.erase(timer->id);
+    callback();
+}
+
+void AmqpTransport::post(std::function<void()> task)
+{
+    executor.post(std::move(task));
+}
+
+void AmqpTransport::run()
+{
+    ev_run(loop, 0);
+}
+
+void AmqpTransport::close()
+{
+    // Живой таймер (прогресс, таймаут задачи) держал бы ev_run и после закрытия соединения
+    executor.post([this] {
+        closing = true;
+        for (auto &[id, timer] : timers) {
+            ev_timer_stop(loop, &timer->watcher);
+        }
+        timers.clear();
+        connection.close();
+    });
+}
+
+void AmqpTransport::Handler::onClosed(AMQP::TcpConnection *)
+{
+    ev_break(loop, EVBREAK_ALL);
+}
+
+} // namespace util
@@ -0,0 +1,112 @@
+#include "chunk_store.hpp"
+
+#include <filesystem>
+#include <stdexcept>
+
+namespace util {
+
+ChunkWriter::ChunkWriter(const std::string &dir, uint64_t job)
+    : path(ChunkReader::pathOf(dir, job)), out(path, std::ios::binary | std::ios::trunc)
+{
+    if (!out) {
+        throw std::runtime_error("ChunkWriter: cannot create " + path);
+    }
+}
+
+void ChunkWriter::put(uint64_t chunk, const SentenceStore &sentences)
+{
+    auto count = static_cast<uint32_t>(sentences.size());
+    out.write(reinterpret_cast<const char *>(&chunk), sizeof(chunk));
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    for (auto sentence : sentences) {
+        auto length = static_cast<uint32_t>(sentence.size());
+        out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+    }
+    for (auto sentence : sentences) {
+        out.write(sentence.data(), static_cast<std::streamsize>(sentence.size()));
+    }
+    // Чанк должен оказаться в файле раньше, чем агрегатор получит результат по нему
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("ChunkWriter::put: cannot write " + path);
+    }
+}
+
+ChunkReader::ChunkReader(const std::string &dir, uint64_t job) : path(pathOf(dir, job)), in(path, std::ios::binary)
+{
+    if (!in) {
+        throw std::runtime_error("ChunkReader: cannot open " + path);
+    }
+
+    // Читаем только заголовки записей, текст остаётся на диске до запроса
+    uint64_t chunk = 0;
+    while (in.read(reinterpret_cast<char *>(&chunk), sizeof(chunk))) {
+        uint32_t count = 0;
+        std::vector<uint32_t> lengths;
+        in.read(reinterpret_cast<char *>(&count), sizeof(count));
+        lengths.resize(count);
+        in.read(reinterpret_cast<char *>(lengths.data()), static_cast<std::streamsize>(count * sizeof(uint32_t)));
+        if (!in) {
+            throw std::runtime_error("ChunkReader: truncated record in " + path);
+        }
+
+        auto &offsets = chunks[chunk].offsets;
+        offsets.resize(count + 1);
+        offsets[0] = static_cast<uint64_t>(in.tellg());
+        for (uint32_t i = 0; i < count; ++i) {
+            offsets[i + 1] = offsets[i] + lengths[i];
+        }
+        in.seekg(static_cast<std::streamoff>(offsets.back()));
+    }
+    in.clear();
+}
+
+SentenceStore ChunkReader::sentences(uint64_t chunk)
+{
+    const auto &offsets = find(chunk).offsets;
+    std::string text(offsets.back() - offsets.front(), '\0');
+    in.seekg(static_cast<std::streamoff>(offsets.front()));
+    in.read(text.data(), static_cast<std::streamsize>(text.size()));
+    if (!in) {
+        throw std::runtime_error("ChunkReader::sentences: truncated chunk in " + path);
+    }
+
+    SentenceStore result;
+    result.reserve(text.size(), offsets.size() - 1);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        result.add(std::string_view(text).substr(offsets[i] - offsets.front(), offsets[i + 1] - offsets[i]));
+    }
+    return result;
+}
+
+std::string ChunkReader::sentence(uint64_t chunk, size_t index)
+{
+    const auto &offsets = find(chunk).offsets;
+    if (index + 1 >= offsets.size()) {
+        throw std::runtime_error("ChunkReader::sentence: no sentence " + std::to_string(index) + " in chunk " +
+                                 std::to_string(chunk));
+    }
+    std::string text(offsets[index + 1] - offsets[index], '\0');
+    in.seekg(static_cast<std::streamoff>(offsets[index]));
+    in.read(text.data(), static_cast<std::streamsize>(text.size()));
+    if (!in) {
+        throw std::runtime_error("ChunkReader::sentence: truncated chunk in " + path);
+    }
+    return text;
+}
+
+std::string ChunkReader::pathOf(const std::string &dir, uint64_t job)
+{
+    return (std::filesystem::path(dir) / ("lab2-" + std::to_string(job) + ".chunks")).string();
+}
+
+const ChunkReader::Chunk &ChunkReader::find(uint64_t chunk) const
+{
+    auto it = chunks.find(chunk);
+    if (it == chunks.end()) {
+        throw std::runtime_error("ChunkReader: chunk " + std::to_string(chunk) + " is missing in " + path);
+    }
+    return it->second;
+}
+
+} // namespace util
@@ -0,0 +1,48 @@
+#include "config.hpp"
+
+#include <cstdlib>
+#include <stdexcept>
+
+namespace util {
+
+std::string envString(const char *name, const std::string &fallback)
+{
+    const char *value = std::getenv(name);
+    return value != nullptr && *value != '\0' ? std::string(value) : fallback;
+}
+
+size_t envSize(const char *name, size_t fallback)
+{
+    const char *value = std::getenv(name);
+    if (value == nullptr || *value == '\0') {
+        return fallback;
+    }
+
+    try {
+        return std::stoull(value);
+    } catch (const std::exception &) {
+        throw std::runtime_error(std::string("envSize: ") + name + " is not a number: " + value);
+    }
+}
+
+double envDouble(const char *name, double fallback)
+{
+    const char *value = std::getenv(name);
+    if (value == nullptr || *value == '\0') {
+        return fallback;
+    }
+
+    try {
+        return std::stod(value);
+    } catch (const std::exception &) {
+        throw std::runtime_error(std::string("envDouble: ") + name + " is not a number: " + value);
+    }
+}
+
+bool verbose()
+{
+    static const bool enabled = envSize("LAB2_VERBOSE", 0) != 0;
+    return enabled;
+}
+
+} // namespace util
@@ -0,0 +1,287 @@
+#include "inproc_transport.hpp"
+
+#include <algorithm>
+
+namespace util {
+
+void InProcBroker::declare(const std::string &name, uint8_t max_priority)
+{
+    std::lock_guard lock(mutex);
+    auto &levels = queues[name];
+    while (levels.size() <= max_priority) {
+        levels.push_back(std::make_unique<Queue>(queue_capacity));
+    }
+}
+
+InProcBroker::Queue &InProcBroker::queue(const std::string &name, uint8_t priority)
+{
+    std::lock_guard lock(mutex);
+    auto &levels = queues[name];
+    if (levels.empty()) {
+        levels.push_back(std::make_unique<Queue>(queue_capacity));
+    }
+    return *levels[std::min<size_t>(priority, levels.size() - 1)];
+}
+
+std::vector<InProcBroker::Queue *> InProcBroker::levels(const std::string &name)
+{
+    queue(name);
+    std::lock_guard lock(mutex);
+    std::vector<Queue *> result;
+    for (auto it = queues[name].rbegin(); it != queues[name].rend(); ++it) {
+        result.push_back(it->get());
+    }
+    return result;
+}
+
+void InProcBroker::notify()
+{
+    // seq_cst с обеих сторон: либо ждущий увидит новый счётчик, либо здесь увидим ждущего
+    event_count.fetch_add(1);
+    if (sleepers.load() > 0) {
+        std::lock_guard lock(mutex);
+        woken.notify_all();
+    }
+}
+
+void InProcBroker::wait(std::chrono::steady_clock::time_point deadline, uint64_t seen)
+{
+    std::unique_lock lock(mutex);
+    sleepers.fetch_add(1);
+    auto changed = [&] { return event_count.load() != seen; };
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        woken.wait(lock, changed);
+    } else {
+        woken.wait_until(lock, deadline, changed);
+    }
+    sleepers.fetch_sub(1);
+}
+
+void InProcBroker::writerWaiting(bool waiting)
+{
+    waiting_writers.fetch_add(waiting ? 1 : -1);
+    // Пара к барьеру в popped(): либо следующая попытка писателя увидит освобождённую ячейку,
+    // либо читатель увидит писателя и разбудит его
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void InProcBroker::popped()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_writers.load(std::memory_order_relaxed) > 0) {
+        notify();
+    }
+}
+
+void InProcTransport::declareQueue(const std::string &name, std::function<void()> ready, uint8_t max_priority,
+                                   [[maybe_unused]] bool temporary)
+{
+    broker.declare(name, max_priority);
+    if (ready) {
+        post(std::move(ready));
+    }
+}
+
+void InProcTransport::consume(const std::string &queue, size_t prefetch, Consumer consumer)
+{
+    subscriptions.push_back({broker.levels(queue), prefetch, std::move(consumer)});
+}
+
+void InProcTransport::ack(uint64_t delivery_tag, bool multiple)
+{
+    auto release = [&](std::map<uint64_t, size_t>::iterator it) {
+        --subscriptions[it->second].unacked;
+        return unacked.erase(it);
+    };
+    if (multiple) {
+        for (auto it = unacked.begin(); it != unacked.end() && it->first <= delivery_tag;) {
+            it = release(it);
+        }
+    } else if (auto it = unacked.find(delivery_tag); it != unacked.end()) {
+        release(it);
+    }
+}
+
+void InProcTransport::push(const std::string &queue, std::string_view body, std::string_view content_type,
+                           uint8_t priority, std::string_view content_encoding, std::function<void(Confirm)> confirmed)
+{
+    auto &ring = broker.queue(queue, priority);
+    InProcBroker::Envelope envelope{std::string(body), std::string(content_type), std::string(content_encoding)};
+    // Пока в эту очередь есть отложенные сообщения, новое встаёт за ними, чтобы не обогнать их
+    bool behind =
+        std::any_of(pending.begin(), pending.end(), [&](const Pending &item) { return item.queue == &ring; });
+    if (!behind && ring.tryPush(std::move(envelope))) {
+        broker.notify();
+        if (confirmed) {
+            // Подтверждение асинхронно, как у брокера: вызывающий не должен получить его до возврата из publish
+            post([confirmed = std::move(confirmed)] { confirmed(Confirm::Ack); });
+        }
+        return;
+    }
+    if (pending.empty()) {
+        broker.writerWaiting(true);
+    }
+    pending.push_back({&ring, std::move(envelope), std::move(confirmed)});
+}
+
+bool InProcTransport::flushPending()
+{
+    if (pending.empty()) {
+        return false;
+    }
+    bool pushed = false;
+    // Очереди, куда не влезло: следующие сообщения в них ждут, чтобы сохранить порядок
+    std::vector<InProcBroker::Queue *> full;
+    for (auto it = pending.begin(); it != pending.end();) {
+        bool blocked = std::find(full.begin(), full.end(), it->queue) != full.end();
+        if (blocked || !it->queue->tryPush(std::move(it->envelope))) {
+            full.push_back(it->queue);
+            ++it;
+            continue;
+        }
+        if (it->confirmed) {
+            post([confirmed = std::move(it->confirmed)] { confirmed(Confirm::Ack); });
+        }
+        it = pending.erase(it);
+        pushed = true;
+    }
+    if (pushed) {
+        broker.notify();
+    }
+    if (pending.empty()) {
+        broker.writerWaiting(false);
+    }
+    return pushed;
+}
+
+void InProcTransport::publish(const std::string &queue, std::string_view body, std::string_view content_type,
+                              uint8_t priority, std::string_view content_encoding)
+{
+    push(queue, body, content_type, priority, content_encoding, {});
+}
+
+void InProcTransport::publishConfirmed(const std::string &queue, std::string_view body, std::string_view content_type,
+                                       std::function<void(Confirm)> confirmed, uint8_t priority,
+                                       std::string_view content_encoding)
+{
+    push(queue, body, content_type, priority, content_encoding, std::move(confirmed));
+}
+
+uint64_t InProcTransport::startTimer(double seconds, std::function<void()> callback)
+{
+    auto delay =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    auto deadline = std::chrono::steady_clock::now() + delay;
+    timers.emplace(++next_timer, Timer{deadline, std::move(callback)});
+    return next_timer;
+}
+
+void InProcTransport::stopTimer(uint64_t id)
+{
+    timers.erase(id);
+}
+
+void InProcTransport::post(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(posted_mutex);
+        posted.push_back(std::move(task));
+        has_posted.store(true);
+    }
+    broker.notify();
+}
+
+void InProcTransport::close()
+{
+    stopping.store(true);
+    broker.notify();
+}
+
+bool InProcTransport::runPosted()
+{
+    if (!has_posted.load()) {
+        return false;
+    }
+    std::vector<std::function<void()>> batch;
+    {
+        std::lock_guard lock(posted_mutex);
+        batch.swap(posted);
+        has_posted.store(false);
+    }
+    for (auto &task : batch) {
+        task();
+    }
+    return !batch.empty();
+}
+
+bool InProcTransport::runTimers()
+{
+    bool fired = false;
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = timers.begin(); it != timers.end();) {
+        if (it->second.deadline > now) {
+            ++it;
+            continue;
+        }
+        auto callback = std::move(it->second.callback);
+        it = timers.erase(it);
+        callback();
+        fired = true;
+        // Колбэк мог добавить или снять таймеры
+        it = timers.begin();
+        now = std::chrono::steady_clock::now();
+    }
+    return fired;
+}
+
+bool InProcTransport::deliver()
+{
+    // Ограничение на пачку, чтобы post() и таймеры не голодали под потоком сообщений
+    constexpr size_t MAX_BATCH = 64;
+
+    bool delivered = false;
+    InProcBroker::Envelope envelope;
+    for (size_t index = 0; index < subscriptions.size(); ++index) {
+        auto &subscription = subscriptions[index];
+        for (size_t i = 0; i < MAX_BATCH; ++i) {
+            if (subscription.prefetch != 0 && subscription.unacked >= subscription.prefetch) {
+                break;
+            }
+            auto level = std::find_if(subscription.levels.begin(), subscription.levels.end(),
+                                      [&](InProcBroker::Queue *queue) { return queue->tryPop(envelope); });
+            if (level == subscription.levels.end()) {
+                break;
+            }
+            broker.popped();
+            uint64_t tag = ++next_tag;
+            unacked.emplace(tag, index);
+            ++subscription.unacked;
+            subscription.consumer(Message{envelope.body, envelope.content_type, envelope.content_encoding, tag});
+            delivered = true;
+        }
+    }
+    return delivered;
+}
+
+void InProcTransport::run()
+{
+    while (!stopping.load()) {
+        // Событие после этой точки не даст уснуть, даже если проход ниже его не застал
+        uint64_t seen = broker.events();
+        bool busy = flushPending();
+        busy |= runPosted();
+        busy |= runTimers();
+        busy |= deliver();
+        if (busy) {
+            continue;
+        }
+
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        for (const auto &[id, timer] : timers) {
+            deadline = std::min(deadline, timer.deadline);
+        }
+        broker.wait(deadline, seen);
+    }
+}
+
+} // namespace util
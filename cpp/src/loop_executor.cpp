@@ -0,0 +1,42 @@
+#include "loop_executor.hpp"
+
+namespace util {
+
+LoopExecutor::LoopExecutor(struct ev_loop *loop) : loop(loop)
+{
+    ev_async_init(&async, &LoopExecutor::onAsync);
+    async.data = this;
+    ev_async_start(loop, &async);
+    // Сам по себе executor не держит цикл: ev_run завершается, когда закрыто соединение
+    ev_unref(loop);
+}
+
+LoopExecutor::~LoopExecutor()
+{
+    ev_ref(loop);
+    ev_async_stop(loop, &async);
+}
+
+void LoopExecutor::post(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    ev_async_send(loop, &async);
+}
+
+void LoopExecutor::onAsync(struct ev_loop *, ev_async *watcher, int)
+{
+    auto *self = static_cast<LoopExecutor *>(watcher->data);
+    std::vector<std::function<void()>> batch;
+    {
+        std::lock_guard lock(self->mutex);
+        batch.swap(self->tasks);
+    }
+    for (auto &task : batch) {
+        task();
+    }
+}
+
+} // namespace util
@@ -0,0 +1,278 @@
+#include "metrics.hpp"
+#include "config.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+namespace util {
+namespace {
+// Наибольшее значение, попадающее в корзину i
+uint64_t upperBound(size_t i)
+{
+    return i == 0 ? 0 : i >= 64 ? UINT64_MAX : (uint64_t(1) << i) - 1;
+}
+}
+
+std::string labelValue(std::string_view value)
+{
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        switch (c) {
+        case '\\': out += "\\\\"; break;
+        case '"': out += "\\\""; break;
+        case '\n': out += "\\n"; break;
+        default: out += c;
+        }
+    }
+    return out;
+}
+
+uint64_t Histogram::Snapshot::percentile(double p) const
+{
+    if (count == 0) {
+        return 0;
+    }
+    auto rank = static_cast<uint64_t>(p * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return upperBound(i);
+        }
+    }
+    return UINT64_MAX;
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot result;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        result.count += result.buckets[i];
+    }
+    result.sum = sum.load(std::memory_order_relaxed);
+    return result;
+}
+
+Metrics &Metrics::global()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Counter &Metrics::counter(const std::string &name, const std::string &help)
+{
+    std::lock_guard lock(mutex);
+    for (auto &entry : counters) {
+        if (entry.name == name) {
+            return *entry.metric;
+        }
+    }
+    return *counters.emplace_back(Entry<Counter>{name, help, std::make_unique<Counter>()}).metric;
+}
+
+Histogram &Metrics::histogram(const std::string &name, const std::string &help)
+{
+    std::lock_guard lock(mutex);
+    for (auto &entry : histograms) {
+        if (entry.name == name) {
+            return *entry.metric;
+        }
+    }
+    return *histograms.emplace_back(Entry<Histogram>{name, help, std::make_unique<Histogram>()}).metric;
+}
+
+GaugeFamily &Metrics::gauges(const std::string &name, const std::string &help)
+{
+    std::lock_guard lock(mutex);
+    for (auto &entry : gauge_families) {
+        if (entry.name == name) {
+            return *entry.metric;
+        }
+    }
+    return *gauge_families.emplace_back(Entry<GaugeFamily>{name, help, std::make_unique<GaugeFamily>()}).metric;
+}
+
+std::string Metrics::prometheus() const
+{
+    std::lock_guard lock(mutex);
+    std::string out;
+    auto it = std::back_inserter(out);
+
+    for (const auto &entry : counters) {
+        fmt::format_to(it, "# HELP {} {}\n# TYPE {} counter\n{} {}\n", entry.name, entry.help, entry.name, entry.name,
+                       entry.metric->value());
+    }
+    for (const auto &entry : histograms) {
+        auto snapshot = entry.metric->snapshot();
+        fmt::format_to(it, "# HELP {} {}\n# TYPE {} histogram\n", entry.name, entry.help, entry.name);
+        // Пустые старшие корзины не выводим, +Inf всё равно покрывает остаток
+        size_t last = 0;
+        for (size_t i = 0; i < snapshot.buckets.size(); ++i) {
+            if (snapshot.buckets[i] != 0) {
+                last = i;
+            }
+        }
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i <= last; ++i) {
+            cumulative += snapshot.buckets[i];
+            double bound = static_cast<double>(upperBound(i)) / 1e6;
+            fmt::format_to(it, "{}_bucket{{le=\"{}\"}} {}\n", entry.name, bound, cumulative);
+        }
+        fmt::format_to(it, "{}_bucket{{le=\"+Inf\"}} {}\n", entry.name, snapshot.count);
+        fmt::format_to(it, "{}_sum {}\n{}_count {}\n", entry.name, snapshot.sum / 1e6, entry.name, snapshot.count);
+    }
+    for (const auto &entry : gauge_families) {
+        fmt::format_to(it, "# HELP {} {}\n# TYPE {} gauge\n", entry.name, entry.help, entry.name);
+        for (const auto &[labels, value] : entry.metric->snapshot()) {
+            fmt::format_to(it, "{}{{{}}} {}\n", entry.name, labels, value);
+        }
+    }
+    return out;
+}
+
+std::string Metrics::summary() const
+{
+    std::lock_guard lock(mutex);
+    std::string out;
+    auto it = std::back_inserter(out);
+    for (const auto &entry : counters) {
+        fmt::format_to(it, "{:<44} {}\n", entry.name, entry.metric->value());
+    }
+    for (const auto &entry : histograms) {
+        auto snapshot = entry.metric->snapshot();
+        if (snapshot.count == 0) {
+            continue;
+        }
+        fmt::format_to(it, "{:<44} n={} mean={}us p50<={}us p99<={}us\n", entry.name, snapshot.count,
+                       snapshot.sum / snapshot.count, snapshot.percentile(0.5), snapshot.percentile(0.99));
+    }
+    for (const auto &entry : gauge_families) {
+        for (const auto &[labels, value] : entry.metric->snapshot()) {
+            fmt::format_to(it, "{:<44} {}\n", fmt::format("{}{{{}}}", entry.name, labels), value);
+        }
+    }
+    return out;
+}
+
+MetricsExporter::MetricsExporter(uint16_t port, double dump_interval, const std::string &address)
+{
+    if (port != 0) {
+        sockaddr_in endpoint{};
+        endpoint.sin_family = AF_INET;
+        endpoint.sin_port = htons(port);
+        if (::inet_pton(AF_INET, address.c_str(), &endpoint.sin_addr) != 1) {
+            throw std::runtime_error("MetricsExporter: invalid address '" + address + "'");
+        }
+
+        listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<sockaddr *>(&endpoint), sizeof(endpoint)) != 0 ||
+            ::listen(listen_fd, 16) != 0) {
+            int error = errno;
+            if (listen_fd >= 0) {
+                ::close(listen_fd);
+            }
+            throw std::runtime_error(fmt::format("MetricsExporter: cannot listen on {}:{}: {}", address, port,
+                                                 std::strerror(error)));
+        }
+        server = std::thread([this] { serve(); });
+    }
+    if (dump_interval > 0) {
+        dumper = std::thread([this, dump_interval] { dump(dump_interval); });
+    }
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    stop_requested.notify_all();
+    if (listen_fd >= 0) {
+        // Будит accept() в потоке сервера
+        ::shutdown(listen_fd, SHUT_RDWR);
+    }
+    if (server.joinable()) {
+        server.join();
+    }
+    if (dumper.joinable()) {
+        dumper.join();
+        // Итоговая сводка, чтобы короткий запуск не остался без неё
+        fmt::print(stderr, "--- metrics ---\n{}", Metrics::global().summary());
+    }
+    if (listen_fd >= 0) {
+        ::close(listen_fd);
+    }
+}
+
+std::unique_ptr<MetricsExporter> MetricsExporter::fromEnv()
+{
+    auto port = envSize("LAB2_METRICS_PORT", 0);
+    double interval = envDouble("LAB2_METRICS_DUMP_S", 0);
+    if (port == 0 && interval <= 0) {
+        return nullptr;
+    }
+    return std::make_unique<MetricsExporter>(static_cast<uint16_t>(port), interval,
+                                             envString("LAB2_METRICS_ADDR", "127.0.0.1"));
+}
+
+void MetricsExporter::serve()
+{
+    while (true) {
+        int client = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        // Сервер однопоточный: клиент, который молчит или не читает ответ, держит его не дольше таймаута,
+        // иначе он задержал бы остальных и деструктор, ждущий этот поток
+        timeval timeout{.tv_sec = 1, .tv_usec = 0};
+        ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        // Запрос не разбираем: любой GET получает метрики
+        char request[1024];
+        [[maybe_unused]] auto received = ::recv(client, request, sizeof(request), 0);
+
+        auto body = Metrics::global().prometheus();
+        auto response = fmt::format("HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                    "Content-Length: {}\r\nConnection: close\r\n\r\n{}",
+                                    body.size(), body);
+        std::string_view rest = response;
+        while (!rest.empty()) {
+            auto sent = ::send(client, rest.data(), rest.size(), MSG_NOSIGNAL);
+            if (sent <= 0) {
+                break;
+            }
+            rest.remove_prefix(static_cast<size_t>(sent));
+        }
+        ::close(client);
+    }
+}
+
+void MetricsExporter::dump(double interval)
+{
+    auto period =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(interval));
+    std::unique_lock lock(mutex);
+    while (!stop_requested.wait_for(lock, period, [&] { return stopping; })) {
+        fmt::print(stderr, "--- metrics ---\n{}", Metrics::global().summary());
+    }
+}
+
+} // namespace util
@@ -0,0 +1,203 @@
+#include "name_scanner.hpp"
+
+#include <array>
+#include <bit>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace util {
+namespace {
+constexpr std::array<bool, 256> WORD_CHARS = [] {
+    std::array<bool, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+        table[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+    return table;
+}();
+
+bool isWordChar(char c)
+{
+    return WORD_CHARS[static_cast<unsigned char>(c)];
+}
+
+bool isUpper(char c)
+{
+    return c >= 'A' && c <= 'Z';
+}
+
+bool isLower(char c)
+{
+    return c >= 'a' && c <= 'z';
+}
+
+// Позиция первой заглавной ASCII-буквы, начиная с from, или text.size()
+size_t findUpper(std::string_view text, size_t from)
+{
+    const char *data = text.data();
+    size_t i = from;
+
+#if defined(__AVX2__)
+    // После сдвига на 0x3F заглавные попадают в [-128, -103], всё остальное больше
+    const __m256i shift32 = _mm256_set1_epi8(0x3F);
+    const __m256i limit32 = _mm256_set1_epi8(-128 + 26);
+    for (; i + 32 <= text.size(); i += 32) {
+        __m256i block = _mm256_add_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)), shift32);
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(limit32, block)));
+        if (mask != 0) {
+            return i + std::countr_zero(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i shift16 = _mm_set1_epi8(0x3F);
+    const __m128i limit16 = _mm_set1_epi8(-128 + 26);
+    for (; i + 16 <= text.size(); i += 16) {
+        __m128i block = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), shift16);
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmplt_epi8(block, limit16)));
+        if (mask != 0) {
+            return i + std::countr_zero(mask);
+        }
+    }
+#endif
+
+    for (; i < text.size(); ++i) {
+        if (isUpper(data[i])) {
+            return i;
+        }
+    }
+    return text.size();
+}
+
+size_t wordEnd(std::string_view text, size_t start)
+{
+    while (start < text.size() && isWordChar(text[start])) {
+        ++start;
+    }
+    return start;
+}
+
+bool isCapitalized(std::string_view word)
+{
+    if (word.empty() || !isUpper(word[0])) {
+        return false;
+    }
+    for (size_t i = 1; i < word.size(); ++i) {
+        if (!isLower(word[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+Gazetteer Gazetteer::load(const std::string &filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Gazetteer::load: Could not open " + filename);
+    }
+
+    Gazetteer gazetteer;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string_view name = line;
+        while (!name.empty() && std::isspace(static_cast<unsigned char>(name.back()))) {
+            name.remove_suffix(1);
+        }
+        if (!name.empty() && name.front() != '#') {
+            gazetteer.add(name);
+        }
+    }
+    return gazetteer;
+}
+
+void Gazetteer::add(std::string_view name)
+{
+    if (!names.count(name)) {
+        names.add(name);
+    }
+}
+
+bool Gazetteer::contains(std::string_view word) const
+{
+    return names.count(word) != 0;
+}
+
+size_t Gazetteer::size() const
+{
+    return names.size();
+}
+
+NameScanner::NameScanner(NameRules rules) : rules(rules) {}
+
+template <typename OnName>
+void NameScanner::scan(std::string_view sentence, OnName on_name) const
+{
+    size_t first_word = 0;
+    while (first_word < sentence.size() && !isWordChar(sentence[first_word])) {
+        ++first_word;
+    }
+
+    size_t i = 0;
+    while (i < sentence.size()) {
+        // Без справочника имя может начинаться только с заглавной буквы - прыгаем сразу к ней
+        size_t start = rules.gazetteer == nullptr ? findUpper(sentence, i) : i;
+        if (start >= sentence.size()) {
+            break;
+        }
+        if (!isWordChar(sentence[start])) {
+            i = start + 1;
+            continue;
+        }
+        if (start > 0 && isWordChar(sentence[start - 1])) {
+            // Середина слова: \b не сработает, пропускаем слово целиком
+            i = wordEnd(sentence, start);
+            continue;
+        }
+
+        size_t end = wordEnd(sentence, start);
+        std::string_view word = sentence.substr(start, end - start);
+
+        bool is_name = rules.capitalized && isCapitalized(word) && !(rules.skip_sentence_initial && start == first_word);
+        if (!is_name && rules.gazetteer != nullptr) {
+            is_name = rules.gazetteer->contains(word);
+        }
+
+        if (is_name) {
+            on_name(start, end);
+        }
+        i = end;
+    }
+}
+
+void NameScanner::replace(std::string_view sentence, std::string_view replacement, std::string &out) const
+{
+    size_t copied = 0;
+    scan(sentence, [&](size_t start, size_t end) {
+        out.append(sentence.substr(copied, start - copied));
+        out.append(replacement);
+        copied = end;
+    });
+    out.append(sentence.substr(copied));
+}
+
+std::string NameScanner::replace(std::string_view sentence, std::string_view replacement) const
+{
+    std::string out;
+    out.reserve(sentence.size());
+    replace(sentence, replacement, out);
+    return out;
+}
+
+void NameScanner::find(std::string_view sentence, std::vector<Span> &out) const
+{
+    scan(sentence, [&](size_t start, size_t end) {
+        out.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(end - start)});
+    });
+}
+
+} // namespace util
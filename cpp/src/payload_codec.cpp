@@ -0,0 +1,210 @@
+#include "payload_codec.hpp"
+#include "config.hpp"
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include <lz4.h>
+#include <zdict.h>
+#include <zstd.h>
+
+namespace util {
+namespace {
+// Больше не бывает ни одного сообщения конвейера; защита от мусора в заголовке длины
+constexpr size_t MAX_PAYLOAD = size_t(1) << 30;
+constexpr size_t LZ4_HEADER = 4;
+
+ZSTD_CCtx *compressContext()
+{
+    thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    return context.get();
+}
+
+ZSTD_DCtx *decompressContext()
+{
+    thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    return context.get();
+}
+
+std::string readFile(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("PayloadCodec: cannot read dictionary " + path);
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    return std::move(text).str();
+}
+
+// Сжатое тело пишется в out; false - сжать не удалось или выигрыша нет
+bool compressLz4(std::string_view body, std::string &out)
+{
+    if (body.size() > MAX_PAYLOAD) {
+        return false;
+    }
+    auto size = static_cast<uint32_t>(body.size());
+    out.resize(LZ4_HEADER + LZ4_compressBound(static_cast<int>(size)));
+    for (size_t i = 0; i < LZ4_HEADER; ++i) {
+        out[i] = static_cast<char>(size >> (8 * i));
+    }
+    int written = LZ4_compress_default(body.data(), out.data() + LZ4_HEADER, static_cast<int>(size),
+                                       static_cast<int>(out.size() - LZ4_HEADER));
+    out.resize(LZ4_HEADER + written);
+    return written > 0 && out.size() < body.size();
+}
+
+void decompressLz4(std::string_view body, std::string &out)
+{
+    if (body.size() < LZ4_HEADER) {
+        throw std::runtime_error("PayloadCodec::decompress: truncated lz4 payload");
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < LZ4_HEADER; ++i) {
+        size |= size_t(static_cast<unsigned char>(body[i])) << (8 * i);
+    }
+    if (size > MAX_PAYLOAD) {
+        throw std::runtime_error("PayloadCodec::decompress: lz4 payload is too large");
+    }
+    out.resize(size);
+    int read = LZ4_decompress_safe(body.data() + LZ4_HEADER, out.data(), static_cast<int>(body.size() - LZ4_HEADER),
+                                   static_cast<int>(size));
+    if (read < 0 || static_cast<size_t>(read) != size) {
+        throw std::runtime_error("PayloadCodec::decompress: corrupted lz4 payload");
+    }
+}
+}
+
+CompressionOptions CompressionOptions::fromEnv()
+{
+    CompressionOptions options;
+    options.codec = codecFromName(envString("LAB2_COMPRESSION", "none"));
+    options.min_bytes = envSize("LAB2_COMPRESSION_MIN", options.min_bytes);
+    options.level = static_cast<int>(envSize("LAB2_ZSTD_LEVEL", options.level));
+    options.dictionary = envString("LAB2_ZSTD_DICT", "");
+    return options;
+}
+
+Codec codecFromName(std::string_view name)
+{
+    if (name == "none" || name.empty()) {
+        return Codec::None;
+    }
+    if (name == "lz4") {
+        return Codec::Lz4;
+    }
+    if (name == "zstd") {
+        return Codec::Zstd;
+    }
+    throw std::runtime_error("codecFromName: unknown codec '" + std::string(name) + "'");
+}
+
+std::string_view codecName(Codec codec)
+{
+    switch (codec) {
+    case Codec::Lz4: return "lz4";
+    case Codec::Zstd: return "zstd";
+    case Codec::None: break;
+    }
+    return "";
+}
+
+PayloadCodec::PayloadCodec(CompressionOptions options) : options(std::move(options))
+{
+    // Словарь загружается и без своего сжатия: его могут использовать сообщения от других стадий
+    if (!this->options.dictionary.empty()) {
+        auto dictionary = readFile(this->options.dictionary);
+        compress_dictionary = ZSTD_createCDict(dictionary.data(), dictionary.size(), this->options.level);
+        decompress_dictionary = ZSTD_createDDict(dictionary.data(), dictionary.size());
+        if (compress_dictionary == nullptr || decompress_dictionary == nullptr) {
+            throw std::runtime_error("PayloadCodec: invalid dictionary " + this->options.dictionary);
+        }
+    }
+}
+
+PayloadCodec::~PayloadCodec()
+{
+    ZSTD_freeCDict(compress_dictionary);
+    ZSTD_freeDDict(decompress_dictionary);
+}
+
+std::string_view PayloadCodec::compress(std::string &body) const
+{
+    if (options.codec == Codec::None || body.size() < options.min_bytes) {
+        return {};
+    }
+
+    std::string out;
+    if (options.codec == Codec::Lz4) {
+        if (!compressLz4(body, out)) {
+            return {};
+        }
+    } else {
+        out.resize(ZSTD_compressBound(body.size()));
+        size_t written = compress_dictionary != nullptr
+                             ? ZSTD_compress_usingCDict(compressContext(), out.data(), out.size(), body.data(),
+                                                        body.size(), compress_dictionary)
+                             : ZSTD_compressCCtx(compressContext(), out.data(), out.size(), body.data(), body.size(),
+                                                 options.level);
+        if (ZSTD_isError(written) || written >= body.size()) {
+            return {};
+        }
+        out.resize(written);
+    }
+    body = std::move(out);
+    return codecName(options.codec);
+}
+
+std::string_view PayloadCodec::decompress(std::string_view body, std::string_view content_encoding,
+                                         std::string &buffer) const
+{
+    switch (codecFromName(content_encoding)) {
+    case Codec::None:
+        return body;
+    case Codec::Lz4:
+        decompressLz4(body, buffer);
+        return buffer;
+    case Codec::Zstd:
+        break;
+    }
+
+    auto size = ZSTD_getFrameContentSize(body.data(), body.size());
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN || size > MAX_PAYLOAD) {
+        throw std::runtime_error("PayloadCodec::decompress: invalid zstd frame");
+    }
+    buffer.resize(size);
+    size_t read = decompress_dictionary != nullptr
+                      ? ZSTD_decompress_usingDDict(decompressContext(), buffer.data(), buffer.size(), body.data(),
+                                                   body.size(), decompress_dictionary)
+                      : ZSTD_decompressDCtx(decompressContext(), buffer.data(), buffer.size(), body.data(),
+                                            body.size());
+    if (ZSTD_isError(read) || read != size) {
+        throw std::runtime_error(std::string("PayloadCodec::decompress: ") +
+                                 (ZSTD_isError(read) ? ZSTD_getErrorName(read) : "short zstd frame"));
+    }
+    return buffer;
+}
+
+std::string trainDictionary(const std::vector<std::string> &samples, size_t capacity)
+{
+    std::string joined;
+    std::vector<size_t> sizes;
+    sizes.reserve(samples.size());
+    for (const auto &sample : samples) {
+        joined.append(sample);
+        sizes.push_back(sample.size());
+    }
+
+    std::string dictionary(capacity, '\0');
+    size_t size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), joined.data(), sizes.data(),
+                                        static_cast<unsigned>(sizes.size()));
+    if (ZDICT_isError(size)) {
+        throw std::runtime_error(std::string("trainDictionary: ") + ZDICT_getErrorName(size));
+    }
+    dictionary.resize(size);
+    return dictionary;
+}
+
+} // namespace util
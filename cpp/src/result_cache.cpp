@@ -0,0 +1,156 @@
+#include "result_cache.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#define XXH_STATIC_LINKING_ONLY
+#include <xxhash.h>
+
+namespace util {
+
+uint64_t chunkHash(std::span<const std::string_view> sentences)
+{
+    XXH3_state_t state;
+    XXH3_64bits_reset(&state);
+    for (auto sentence : sentences) {
+        uint64_t length = sentence.size();
+        XXH3_64bits_update(&state, &length, sizeof(length));
+        XXH3_64bits_update(&state, sentence.data(), sentence.size());
+    }
+    // 0 в сообщении означает "хеша нет"
+    uint64_t hash = XXH3_64bits_digest(&state);
+    return hash != 0 ? hash : 1;
+}
+
+uint64_t cacheKey(uint64_t chunk_hash, uint64_t config_hash)
+{
+    return XXH3_64bits_withSeed(&chunk_hash, sizeof(chunk_hash), config_hash);
+}
+
+uint64_t bytesHash(std::string_view bytes)
+{
+    return XXH3_64bits(bytes.data(), bytes.size());
+}
+
+ResultCache::ResultCache(size_t capacity, std::string dir) : capacity(capacity), dir(std::move(dir))
+{
+    if (!this->dir.empty()) {
+        std::filesystem::create_directories(this->dir);
+    }
+}
+
+std::optional<std::string> ResultCache::get(uint64_t key)
+{
+    {
+        std::lock_guard lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->second;
+        }
+    }
+    if (dir.empty()) {
+        return std::nullopt;
+    }
+
+    std::ifstream in(pathOf(key), std::ios::binary);
+    if (!in) {
+        return std::nullopt;
+    }
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    std::string value = std::move(buffer).str();
+
+    std::lock_guard lock(mutex);
+    remember(key, value);
+    return value;
+}
+
+void ResultCache::put(uint64_t key, const std::string &value)
+{
+    {
+        std::lock_guard lock(mutex);
+        remember(key, value);
+    }
+    if (dir.empty()) {
+        return;
+    }
+
+    // Пишем во временный файл и переименовываем: другой воркер не должен прочитать запись наполовину.
+    // Имя выдаёт mkstemp (O_EXCL), так что два писателя - из разных процессов или хостов - не пишут в один файл
+    auto path = pathOf(key);
+    std::string temporary = path + ".XXXXXX";
+    int fd = mkstemp(temporary.data());
+    if (fd < 0) {
+        fmt::println("ResultCache::put: cannot create a temporary file for {}", path);
+        return;
+    }
+    // mkstemp создаёт файл 0600, а каталог может быть общим у воркеров разных пользователей
+    fchmod(fd, 0644);
+    close(fd);
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(value.data(), static_cast<std::streamsize>(value.size()));
+        if (!out) {
+            fmt::println("ResultCache::put: cannot write {}", temporary);
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+    }
+}
+
+void ResultCache::erase(uint64_t key)
+{
+    {
+        std::lock_guard lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            used -= it->second->second.size();
+            entries.erase(it->second);
+            index.erase(it);
+        }
+    }
+    if (!dir.empty()) {
+        std::error_code error;
+        std::filesystem::remove(pathOf(key), error);
+    }
+}
+
+void ResultCache::remember(uint64_t key, std::string value)
+{
+    if (value.size() > capacity) {
+        return;
+    }
+    auto it = index.find(key);
+    if (it != index.end()) {
+        used -= it->second->second.size();
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    used += value.size();
+    entries.emplace_front(key, std::move(value));
+    index[key] = entries.begin();
+    while (used > capacity) {
+        used -= entries.back().second.size();
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+std::string ResultCache::pathOf(uint64_t key) const
+{
+    return (std::filesystem::path(dir) / fmt::format("{:016x}.lab2c", key)).string();
+}
+
+} // namespace util
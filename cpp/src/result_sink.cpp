@@ -0,0 +1,351 @@
+#include "result_sink.hpp"
+#include "config.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+namespace util {
+
+BufferedWriter::BufferedWriter(const std::string &path, size_t buffer_size, size_t depth)
+    : path(path), buffer_size(std::max<size_t>(buffer_size, 4096)), depth(std::max<size_t>(depth, 1))
+{
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("BufferedWriter: cannot open " + path + ": " + std::strerror(errno));
+    }
+    current.reserve(this->buffer_size);
+    writer = std::thread([this] { run(); });
+}
+
+BufferedWriter::~BufferedWriter()
+{
+    try {
+        close();
+    } catch (const std::exception &) {
+        // Деструктор не бросает, об ошибке узнаёт только тот, кто вызвал close() явно
+    }
+}
+
+void BufferedWriter::write(std::string_view data)
+{
+    total += data.size();
+    while (!data.empty()) {
+        size_t part = std::min(data.size(), buffer_size - current.size());
+        current.append(data.substr(0, part));
+        data.remove_prefix(part);
+        if (current.size() == buffer_size) {
+            hand(std::exchange(current, {}));
+            current.reserve(buffer_size);
+        }
+    }
+}
+
+void BufferedWriter::hand(std::string buffer)
+{
+    std::unique_lock lock(mutex);
+    changed.wait(lock, [&] { return queue.size() < depth || error != 0; });
+    queue.push_back(std::move(buffer));
+    changed.notify_all();
+}
+
+void BufferedWriter::close()
+{
+    if (!writer.joinable()) {
+        return;
+    }
+    if (!current.empty()) {
+        hand(std::exchange(current, {}));
+    }
+    {
+        std::lock_guard lock(mutex);
+        closing = true;
+    }
+    changed.notify_all();
+    writer.join();
+
+    if (::close(fd) != 0 && error == 0) {
+        error = errno;
+    }
+    fd = -1;
+    if (error != 0) {
+        throw std::runtime_error("BufferedWriter: failed to write " + path + ": " + std::strerror(error));
+    }
+}
+
+void BufferedWriter::run()
+{
+    while (true) {
+        std::string buffer;
+        {
+            std::unique_lock lock(mutex);
+            changed.wait(lock, [&] { return !queue.empty() || closing; });
+            if (queue.empty()) {
+                return;
+            }
+            buffer = std::move(queue.front());
+            queue.pop_front();
+        }
+        changed.notify_all();
+
+        std::string_view rest = buffer;
+        while (!rest.empty() && error == 0) {
+            ssize_t written = ::write(fd, rest.data(), rest.size());
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::lock_guard lock(mutex);
+                error = errno;
+                changed.notify_all();
+                break;
+            }
+            rest.remove_prefix(static_cast<size_t>(written));
+        }
+    }
+}
+
+namespace {
+using json = nlohmann::json;
+
+void putVarint(std::string &out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void putBytes(std::string &out, std::string_view value)
+{
+    putVarint(out, value.size());
+    out.append(value);
+}
+
+// Длина корректной UTF-8 последовательности в начале text (RFC 3629: без overlong-форм, суррогатов и
+// значений выше U+10FFFF); 0 - последовательность некорректна
+size_t utf8Length(std::string_view text)
+{
+    auto byte = [&](size_t i) { return static_cast<unsigned char>(text[i]); };
+    unsigned char lead = byte(0);
+    size_t length = lead < 0xc2 ? 0 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : lead < 0xf5 ? 4 : 0;
+    if (length == 0 || text.size() < length) {
+        return 0;
+    }
+    // Допустимый диапазон второго байта зависит от первого
+    unsigned char low = lead == 0xe0 ? 0xa0 : lead == 0xf0 ? 0x90 : 0x80;
+    unsigned char high = lead == 0xed ? 0x9f : lead == 0xf4 ? 0x8f : 0xbf;
+    if (byte(1) < low || byte(1) > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; ++i) {
+        if ((byte(i) & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+// Строка JSON из байтов текста: сплиттер не проверяет кодировку корпуса, поэтому некорректные
+// последовательности заменяются на U+FFFD, как в итоге задачи (error_handler_t::replace)
+void escapeJson(std::string &out, std::string_view value)
+{
+    static constexpr char HEX[] = "0123456789abcdef";
+    for (size_t i = 0; i < value.size();) {
+        char c = value[i];
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            size_t length = utf8Length(value.substr(i));
+            if (length == 0) {
+                out += "\xef\xbf\xbd"; // U+FFFD
+                ++i;
+            } else {
+                out.append(value.substr(i, length));
+                i += length;
+            }
+            continue;
+        }
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += "\\u00";
+                out.push_back(HEX[(c >> 4) & 0xf]);
+                out.push_back(HEX[c & 0xf]);
+            } else {
+                out.push_back(c);
+            }
+        }
+        ++i;
+    }
+}
+
+class NdJsonSink : public ResultSink {
+public:
+    explicit NdJsonSink(std::string path) : file(path), writer(file) {}
+
+    void summary(const JobSummary &summary) override
+    {
+        json top = json::array();
+        for (const auto &[word, count] : summary.top_words) {
+            top.push_back({{"word", word}, {"count", count}});
+        }
+        json line = {{"type", "summary"},
+                     {"id", summary.id},
+                     {"total_chunks", summary.total_chunks},
+                     {"word_counts", summary.word_counts},
+                     {"total_words", summary.total_words},
+                     {"sentences", summary.sentences},
+                     {"positive", summary.positive},
+                     {"negative", summary.negative},
+                     {"sentiment", summary.sentiment},
+                     {"top_words", std::move(top)},
+                     {"duration_ms", summary.duration_ms},
+                     {"complete", summary.complete},
+                     {"missing_chunks", summary.missing_chunks}};
+        // Слова - байты из текста, невалидный UTF-8 не должен ронять запись
+        writer.write(line.dump(-1, ' ', false, json::error_handler_t::replace));
+        writer.write("\n");
+    }
+
+    void sorted(std::string_view sentence) override { sentenceLine("sorted", sentence); }
+    void replaced(std::string_view sentence) override { sentenceLine("replaced", sentence); }
+    void close() override { writer.close(); }
+    [[nodiscard]] std::string path() const override { return file; }
+
+private:
+    void sentenceLine(std::string_view type, std::string_view sentence)
+    {
+        line.clear();
+        line += R"({"type":")";
+        line += type;
+        line += R"(","text":")";
+        escapeJson(line, sentence);
+        line += "\"}\n";
+        writer.write(line);
+    }
+
+    std::string file;
+    BufferedWriter writer;
+    std::string line;
+};
+
+// Колоночный файл:
+//   "L2R" version | итог (varint-поля) | байты колонки sorted | байты колонки replaced |
+//   футер: varint число строк и длины каждой колонки | u64 смещение футера | "L2R" version
+class ColumnarSink : public ResultSink {
+public:
+    static constexpr char VERSION = 2;
+
+    explicit ColumnarSink(std::string path) : file(path), writer(file) {}
+
+    void summary(const JobSummary &summary) override
+    {
+        std::string out = {'L', '2', 'R', VERSION};
+        putVarint(out, summary.id);
+        putVarint(out, summary.total_chunks);
+        putVarint(out, summary.total_words);
+        putVarint(out, summary.sentences);
+        putVarint(out, summary.positive);
+        putVarint(out, summary.negative);
+        // zigzag, как svarint в wire_format
+        auto sentiment = static_cast<uint64_t>(summary.sentiment);
+        putVarint(out, (sentiment << 1) ^ static_cast<uint64_t>(summary.sentiment >> 63));
+        putVarint(out, static_cast<uint64_t>(std::max<int64_t>(summary.duration_ms, 0)));
+        putVarint(out, summary.word_counts.size());
+        for (uint64_t count : summary.word_counts) {
+            putVarint(out, count);
+        }
+        putVarint(out, summary.top_words.size());
+        for (const auto &[word, count] : summary.top_words) {
+            putBytes(out, word);
+            putVarint(out, count);
+        }
+        putVarint(out, summary.complete ? 1 : 0);
+        putVarint(out, summary.missing_chunks.size());
+        for (uint64_t chunk : summary.missing_chunks) {
+            putVarint(out, chunk);
+        }
+        writer.write(out);
+    }
+
+    void sorted(std::string_view sentence) override { append(columns[0], sentence); }
+    void replaced(std::string_view sentence) override { append(columns[1], sentence); }
+
+    void close() override
+    {
+        uint64_t footer_offset = writer.written();
+        std::string footer;
+        for (const auto &column : columns) {
+            putVarint(footer, column.count);
+            footer += column.lengths;
+        }
+        for (int shift = 0; shift < 64; shift += 8) {
+            footer.push_back(static_cast<char>((footer_offset >> shift) & 0xff));
+        }
+        footer += {'L', '2', 'R', VERSION};
+        writer.write(footer);
+        writer.close();
+    }
+
+    [[nodiscard]] std::string path() const override { return file; }
+
+private:
+    struct Column {
+        uint64_t count = 0;
+        // Длины строк в varint, в памяти остаётся только этот индекс
+        std::string lengths;
+    };
+
+    void append(Column &column, std::string_view sentence)
+    {
+        ++column.count;
+        putVarint(column.lengths, sentence.size());
+        writer.write(sentence);
+    }
+
+    std::string file;
+    BufferedWriter writer;
+    Column columns[2];
+};
+}
+
+ResultSink::Format ResultSink::formatFromEnv()
+{
+    auto name = envString("LAB2_SINK", "none");
+    if (name == "ndjson") {
+        return Format::NdJson;
+    }
+    if (name == "columnar") {
+        return Format::Columnar;
+    }
+    if (name == "none") {
+        return Format::None;
+    }
+    throw std::runtime_error("ResultSink::formatFromEnv: unknown LAB2_SINK " + name);
+}
+
+std::unique_ptr<ResultSink> ResultSink::open(Format format, const std::string &dir, uint64_t id)
+{
+    auto path = [&](const char *extension) {
+        return (std::filesystem::path(dir) / (std::to_string(id) + extension)).string();
+    };
+
+    switch (format) {
+    case Format::NdJson: return std::make_unique<NdJsonSink>(path(".ndjson"));
+    case Format::Columnar: return std::make_unique<ColumnarSink>(path(".lab2r"));
+    case Format::None: break;
+    }
+    return nullptr;
+}
+
+} // namespace util
@@ -0,0 +1,281 @@
+#include "run_store.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <unistd.h>
+
+namespace util {
+namespace {
+// Примерные накладные расходы std::string в векторе сверх самих символов
+constexpr size_t STRING_OVERHEAD = sizeof(std::string);
+
+size_t runBytes(const std::vector<std::string> &run)
+{
+    size_t bytes = 0;
+    for (const auto &sentence : run) {
+        bytes += sentence.size() + STRING_OVERHEAD;
+    }
+    return bytes;
+}
+
+class Cursor {
+public:
+    virtual ~Cursor() = default;
+    // Переходит к следующей строке; false, если прогон закончился
+    virtual bool next() = 0;
+    [[nodiscard]] std::string_view current() const { return value; }
+    // Откуда строка: номер прогона и позиция в нём. Не зависит от того, когда прогон сбрасывался на диск
+    [[nodiscard]] std::pair<uint64_t, uint32_t> origin() const { return {run_id, position}; }
+
+protected:
+    std::string_view value;
+    uint64_t run_id = 0;
+    uint32_t position = 0;
+};
+
+class MemoryCursor : public Cursor {
+public:
+    MemoryCursor(uint64_t id, const std::vector<std::string> &run) : run(run) { run_id = id; }
+
+    bool next() override
+    {
+        if (index == run.size()) {
+            return false;
+        }
+        position = static_cast<uint32_t>(index);
+        value = run[index++];
+        return true;
+    }
+
+private:
+    const std::vector<std::string> &run;
+    size_t index = 0;
+};
+
+// Читает сегмент файла сброса: последовательность [uint32 длина][байты]; в сегментах ByLength перед
+// каждой строкой ещё её происхождение [uint64 номер прогона][uint32 позиция]
+class FileCursor : public Cursor {
+public:
+    FileCursor(const std::string &path, uint64_t offset, size_t count, bool with_origin)
+        : in(path, std::ios::binary), remaining(count), with_origin(with_origin)
+    {
+        if (!in) {
+            throw std::runtime_error("RunStore::FileCursor: cannot open " + path);
+        }
+        in.seekg(static_cast<std::streamoff>(offset));
+    }
+
+    bool next() override
+    {
+        if (remaining == 0) {
+            return false;
+        }
+        if (with_origin) {
+            in.read(reinterpret_cast<char *>(&run_id), sizeof(run_id));
+            in.read(reinterpret_cast<char *>(&position), sizeof(position));
+        }
+        uint32_t length = 0;
+        in.read(reinterpret_cast<char *>(&length), sizeof(length));
+        buffer.resize(length);
+        in.read(buffer.data(), length);
+        if (!in) {
+            throw std::runtime_error("RunStore::FileCursor: truncated spill file");
+        }
+        --remaining;
+        value = buffer;
+        return true;
+    }
+
+private:
+    std::ifstream in;
+    size_t remaining;
+    bool with_origin;
+    std::string buffer;
+};
+
+std::string spillPath(const std::string &dir)
+{
+    static std::atomic<uint64_t> counter{0};
+    return (std::filesystem::path(dir) /
+            ("lab2-run-" + std::to_string(getpid()) + "-" + std::to_string(counter++) + ".bin"))
+        .string();
+}
+
+void writeString(std::ofstream &out, std::string_view value)
+{
+    auto length = static_cast<uint32_t>(value.size());
+    out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+// k-way слияние по убыванию длины; равные по длине идут по номеру прогона и позиции в нём, поэтому
+// порядок выдачи одинаков при любых сбросах на диск. visit получает курсор с очередной строкой
+template <typename Visit>
+bool mergeCursors(std::vector<std::unique_ptr<Cursor>> &cursors, Visit &&visit)
+{
+    struct Head {
+        size_t length;
+        std::pair<uint64_t, uint32_t> origin;
+        size_t cursor;
+    };
+    auto later = [](const Head &a, const Head &b) {
+        return a.length != b.length ? a.length < b.length : a.origin > b.origin;
+    };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heap(later);
+    auto push = [&](size_t i) {
+        if (cursors[i]->next()) {
+            heap.push({cursors[i]->current().size(), cursors[i]->origin(), i});
+        }
+    };
+
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        push(i);
+    }
+    while (!heap.empty()) {
+        size_t i = heap.top().cursor;
+        heap.pop();
+        if (!visit(*cursors[i])) {
+            return false;
+        }
+        push(i);
+    }
+    return true;
+}
+}
+
+RunStore::RunStore(Order order, std::string spill_dir, size_t memory_limit)
+    : order(order), spill_dir(std::move(spill_dir)), memory_limit(memory_limit)
+{
+}
+
+RunStore::~RunStore()
+{
+    for (const auto &file : files) {
+        std::error_code error;
+        std::filesystem::remove(file, error);
+    }
+}
+
+void RunStore::add(uint64_t run_id, std::vector<std::string> run)
+{
+    memory += runBytes(run);
+    auto &slot = runs[run_id];
+    if (!slot.empty()) {
+        memory -= runBytes(slot);
+    }
+    slot = std::move(run);
+
+    // 0 - без ограничения
+    if (memory_limit != 0 && memory > memory_limit) {
+        spill();
+    }
+}
+
+void RunStore::spill()
+{
+    if (runs.empty()) {
+        return;
+    }
+
+    auto path = spillPath(spill_dir);
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("RunStore::spill: cannot create " + path);
+    }
+    size_t file = files.size();
+    files.push_back(path);
+
+    if (order == Order::ByLength) {
+        // Сливаем всё, что в памяти, в один отсортированный сегмент
+        std::vector<std::unique_ptr<Cursor>> cursors;
+        size_t count = 0;
+        for (const auto &[run_id, run] : runs) {
+            cursors.push_back(std::make_unique<MemoryCursor>(run_id, run));
+            count += run.size();
+        }
+        mergeCursors(cursors, [&](const Cursor &cursor) {
+            auto [run_id, position] = cursor.origin();
+            out.write(reinterpret_cast<const char *>(&run_id), sizeof(run_id));
+            out.write(reinterpret_cast<const char *>(&position), sizeof(position));
+            writeString(out, cursor.current());
+            return true;
+        });
+        segments.emplace(runs.begin()->first, Segment{file, 0, count});
+    } else {
+        for (const auto &[run_id, run] : runs) {
+            segments.emplace(run_id, Segment{file, static_cast<uint64_t>(out.tellp()), run.size()});
+            for (const auto &sentence : run) {
+                writeString(out, sentence);
+            }
+        }
+    }
+
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("RunStore::spill: failed to write " + path);
+    }
+    spilled += static_cast<size_t>(out.tellp());
+    runs.clear();
+    memory = 0;
+}
+
+void RunStore::forEach(const Callback &callback) const
+{
+    if (order == Order::ByLength) {
+        mergeByLength(callback);
+    } else {
+        concatenate(callback);
+    }
+}
+
+void RunStore::mergeByLength(const Callback &callback) const
+{
+    std::vector<std::unique_ptr<Cursor>> cursors;
+    cursors.reserve(segments.size() + runs.size());
+    for (const auto &[run_id, segment] : segments) {
+        cursors.push_back(std::make_unique<FileCursor>(files[segment.file], segment.offset, segment.count, true));
+    }
+    for (const auto &[run_id, run] : runs) {
+        cursors.push_back(std::make_unique<MemoryCursor>(run_id, run));
+    }
+    mergeCursors(cursors, [&](const Cursor &cursor) { return callback(cursor.current()); });
+}
+
+void RunStore::concatenate(const Callback &callback) const
+{
+    auto drain = [&](Cursor &cursor) {
+        while (cursor.next()) {
+            if (!callback(cursor.current())) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Прогоны в памяти и сброшенные на диск перемежаются по номеру
+    auto run = runs.begin();
+    auto segment = segments.begin();
+    while (run != runs.end() || segment != segments.end()) {
+        bool from_memory = segment == segments.end() || (run != runs.end() && run->first < segment->first);
+        if (from_memory) {
+            MemoryCursor cursor(run->first, run->second);
+            if (!drain(cursor)) {
+                return;
+            }
+            ++run;
+        } else {
+            FileCursor cursor(files[segment->second.file], segment->second.offset, segment->second.count, false);
+            if (!drain(cursor)) {
+                return;
+            }
+            ++segment;
+        }
+    }
+}
+
+}
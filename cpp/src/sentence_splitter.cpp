@@ -1,81 +1,189 @@
 #include "sentence_splitter.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iterator>
+#include <thread>
+#include <utility>
+
 namespace util {
 namespace {
-std::unordered_set<std::string> abbreviations{
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+};
+
+std::unordered_set<std::string, StringHash, std::equal_to<>> abbreviations{
         "т.д.",  "т.п.",  "т.е.",  "т.к.", "т.н.",     "т.о.",  "пр.",   "др.",   "г.",    "см.",
         "стр.",  "рис.",  "ул.",   "пер.", "д.",       "кв.",   " Mr.",  " Mrs.", " Dr.",  " Prof.",
         " etc.", " i.e.", " e.g.", " vs.", " approx.", " max.", " min.", " no.",  " vol.", " fig."};
+
+constexpr size_t MIN_SHARD_SIZE = 64 * 1024;
+
+bool isSpace(char c)
+{
+    return std::isspace(static_cast<unsigned char>(c));
+}
+
+template <typename Body>
+void forEachShard(size_t shards, Body &&body)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(shards - 1);
+    for (size_t k = 1; k < shards; ++k) {
+        threads.emplace_back([&body, k] { body(k); });
+    }
+    body(0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+}
+MappedFile::MappedFile(const std::string &filename)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("MappedFile: Could not open " + filename);
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("MappedFile: Could not stat " + filename);
+    }
+
+    size = static_cast<size_t>(st.st_size);
+    if (size > 0) {
+        data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            data = nullptr;
+            ::close(fd);
+            throw std::runtime_error("MappedFile: Could not map " + filename);
+        }
+        // Читаем строго последовательно: ядро может читать вперёд и выкидывать прочитанное
+        ::madvise(data, size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+}
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0))
+{
+}
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other) {
+        if (data) {
+            ::munmap(data, size);
+        }
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+    return *this;
+}
+MappedFile::~MappedFile()
+{
+    if (data) {
+        ::munmap(data, size);
+    }
+}
+std::string_view MappedFile::view() const
+{
+    return {static_cast<const char *>(data), size};
+}
+SentenceStream::SentenceStream(std::string_view text) : text(text) {}
+SentenceStream SentenceStream::fromFile(const std::string &filename)
+{
+    MappedFile file(filename);
+    SentenceStream stream(file.view());
+    stream.file.emplace(std::move(file));
+    return stream;
+}
+std::optional<std::string_view> SentenceStream::next()
+{
+    while (position < text.length()) {
+        size_t end = SentenceSplitter::findSentenceEnd(text, position, text.length());
+        if (end == std::string_view::npos) {
+            end = text.length(); // Последнее предложение
+        }
+        std::string_view cleaned = SentenceSplitter::cleanSentence(text.substr(position, end - position), buffer);
+        position = end;
+        if (!cleaned.empty()) {
+            return cleaned;
+        }
+    }
+    return std::nullopt;
+}
+size_t SentenceStream::bytesConsumed() const
+{
+    return position;
+}
+size_t SentenceStream::totalBytes() const
+{
+    return text.length();
 }
-std::string SentenceSplitter::cleanSentence(const std::string &sentence)
+std::string_view SentenceSplitter::cleanSentence(std::string_view sentence, std::string &buffer)
 {
-    std::string cleaned;
+    // Быстрый путь: нет пробелов по краям и повторных/нестандартных пробельных символов
+    bool alreadyClean = !sentence.empty() && !isSpace(sentence.front()) && !isSpace(sentence.back());
+    for (size_t i = 0; alreadyClean && i < sentence.length(); ++i) {
+        if (isSpace(sentence[i]) && (sentence[i] != ' ' || sentence[i + 1] == ' ')) {
+            alreadyClean = false;
+        }
+    }
+    if (alreadyClean) {
+        return sentence;
+    }
+
+    buffer.clear();
     bool lastWasSpace = false;
     bool hasContent = false;
 
     for (char c : sentence) {
-        if (std::isspace(c)) {
+        if (isSpace(c)) {
             if (!lastWasSpace && hasContent) {
-                cleaned += ' ';
+                buffer += ' ';
                 lastWasSpace = true;
             }
         } else {
-            cleaned += c;
+            buffer += c;
             lastWasSpace = false;
             hasContent = true;
         }
     }
 
-    size_t start = cleaned.find_first_not_of(" \t\n\r");
-    size_t end = cleaned.find_last_not_of(" \t\n\r");
-
-    if (start == std::string::npos) {
-        return "";
+    if (!buffer.empty() && buffer.back() == ' ') {
+        buffer.pop_back();
     }
 
-    return cleaned.substr(start, end - start + 1);
+    return buffer;
 }
-bool SentenceSplitter::isAbbreviation(const std::string &text, size_t pos)
+bool SentenceSplitter::isAbbreviation(std::string_view text, size_t pos)
 {
     size_t start = pos;
-    while (start > 0 && !std::isspace(text[start - 1]) && text[start - 1] != '.') {
+    while (start > 0 && !isSpace(text[start - 1]) && text[start - 1] != '.') {
         --start;
     }
 
-    std::string potentialAbbr = text.substr(start, pos - start + 1);
+    std::string_view potentialAbbr = text.substr(start, pos - start + 1);
 
     if (abbreviations.find(potentialAbbr) != abbreviations.end()) {
         return true;
     }
 
-    if (potentialAbbr.length() == 2 && std::isalpha(potentialAbbr[0]) && potentialAbbr[1] == '.') {
+    if (potentialAbbr.length() == 2 && std::isalpha(static_cast<unsigned char>(potentialAbbr[0])) &&
+        potentialAbbr[1] == '.') {
         return true;
     }
 
     return false;
 }
-bool SentenceSplitter::readAndSplit(const std::string &filename)
-{
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("SentenceSplitter::readAndSplit: Could not open " + filename);
-    }
-
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string content = buffer.str();
-    file.close();
-
-    return splitSentences(content);
-}
-bool SentenceSplitter::splitSentences(const std::string &text)
+size_t SentenceSplitter::findSentenceEnd(std::string_view text, size_t from, size_t limit)
 {
-    sentences.clear();
-    std::string currentSentence;
-
-    for (size_t i = 0; i < text.length(); ++i) {
+    for (size_t i = from; i < limit; ++i) {
         char c = text[i];
-        currentSentence += c;
 
         if (c == '.' || c == '!' || c == '?') {
             bool isSentenceEnd = true;
@@ -88,39 +196,112 @@ bool SentenceSplitter::splitSentences(const std::string &text)
                 }
                 else if (c == '.' && i + 2 < text.length() && text[i + 1] == '.' && text[i + 2] == '.') {
                     isSentenceEnd = false;
-                    currentSentence += text[++i]; // Вторая точка
-                    currentSentence += text[++i]; // Третья точка
+                    i += 2; // Вторая и третья точки
                 }
                 else if (nextChar == '\"' || nextChar == '\'' || nextChar == '»' || nextChar == '”') {
-                    currentSentence += nextChar;
                     i++;
                 }
-                else if (std::islower(nextChar)) {
+                else if (std::islower(static_cast<unsigned char>(nextChar))) {
                     isSentenceEnd = false;
                 }
             }
 
             if (isSentenceEnd) {
-                std::string cleaned = cleanSentence(currentSentence);
-                if (!cleaned.empty()) {
-                    sentences.push_back(cleaned);
-                }
-                currentSentence.clear();
+                return i + 1;
             }
         }
     }
 
-    // Последнее предложение
-    if (!currentSentence.empty()) {
-        std::string cleaned = cleanSentence(currentSentence);
-        if (!cleaned.empty()) {
-            sentences.push_back(cleaned);
+    return std::string_view::npos;
+}
+bool SentenceSplitter::readAndSplit(const std::string &filename, size_t threads)
+{
+    MappedFile file(filename);
+    return threads > 1 ? splitSentencesParallel(file.view(), threads) : splitSentences(file.view());
+}
+bool SentenceSplitter::splitSentences(std::string_view text)
+{
+    sentences.clear();
+    SentenceStream stream(text);
+
+    while (auto sentence = stream.next()) {
+        sentences.add(*sentence);
+    }
+
+    return true;
+}
+bool SentenceSplitter::splitSentencesParallel(std::string_view text, size_t threads)
+{
+    if (threads <= 1 || text.length() < threads * MIN_SHARD_SIZE) {
+        return splitSentences(text);
+    }
+
+    // Граница c безопасна, если text[c - 1] - пробельный символ: ни многоточие, ни кавычка после
+    // точки не могут его поглотить, и разбор с позиции c идёт так же, как в последовательном проходе
+    std::vector<size_t> cuts{0};
+    for (size_t k = 1; k < threads; ++k) {
+        size_t cut = std::max(text.length() * k / threads, cuts.back() + 1);
+        while (cut < text.length() && !isSpace(text[cut - 1])) {
+            ++cut;
+        }
+        if (cut < text.length()) {
+            cuts.push_back(cut);
         }
     }
+    cuts.push_back(text.length());
+    size_t shards = cuts.size() - 1;
+
+    // Концы предложений в каждом диапазоне; предложения через границу склеиваются сами,
+    // потому что начало следующего предложения - это конец предыдущего, где бы он ни был
+    std::vector<std::vector<size_t>> ends(shards);
+    forEachShard(shards, [&](size_t k) {
+        size_t from = cuts[k];
+        while (true) {
+            size_t end = findSentenceEnd(text, from, cuts[k + 1]);
+            if (end == std::string_view::npos) {
+                break;
+            }
+            ends[k].push_back(end);
+            from = end;
+        }
+    });
+
+    std::vector<size_t> boundaries{0};
+    for (const auto &shard_ends : ends) {
+        boundaries.insert(boundaries.end(), shard_ends.begin(), shard_ends.end());
+    }
+    if (boundaries.back() != text.length()) {
+        boundaries.push_back(text.length());
+    }
+
+    // Чистка предложений - тоже параллельно, порядок сохраняется по номерам диапазонов
+    size_t spans = boundaries.size() - 1;
+    std::vector<SentenceStore> cleaned(shards);
+    forEachShard(shards, [&](size_t k) {
+        std::string buffer;
+        for (size_t i = spans * k / shards; i < spans * (k + 1) / shards; ++i) {
+            auto sentence = cleanSentence(text.substr(boundaries[i], boundaries[i + 1] - boundaries[i]), buffer);
+            if (!sentence.empty()) {
+                cleaned[k].add(sentence);
+            }
+        }
+    });
+
+    sentences.clear();
+    size_t bytes = 0;
+    size_t count = 0;
+    for (const auto &shard : cleaned) {
+        bytes += shard.bytes();
+        count += shard.size();
+    }
+    sentences.reserve(bytes, count);
+    for (const auto &shard : cleaned) {
+        sentences.append(shard);
+    }
 
     return true;
 }
-const std::vector<std::string> &SentenceSplitter::getSentences() const
+const SentenceStore &SentenceSplitter::getSentences() const
 {
     return sentences;
 }
@@ -0,0 +1,396 @@
+#include "stages.hpp"
+#include "chunk_store.hpp"
+#include "config.hpp"
+#include "metrics.hpp"
+#include "result_cache.hpp"
+#include "sentence_splitter.hpp"
+#include "words_util.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace util {
+namespace {
+struct SplitterMetrics {
+    Histogram &chunk = Metrics::global().histogram("lab2_splitter_chunk_seconds", "Reading and splitting of a chunk");
+    Histogram &hash = Metrics::global().histogram("lab2_splitter_hash_seconds", "Hashing of a chunk for the cache");
+    Histogram &encode = Metrics::global().histogram("lab2_splitter_encode_seconds", "Encoding of a task message");
+    Histogram &compress =
+        Metrics::global().histogram("lab2_splitter_compress_seconds", "Compression of a task message");
+    Histogram &confirm =
+        Metrics::global().histogram("lab2_splitter_confirm_seconds", "From publish to broker confirmation");
+    Counter &chunks = Metrics::global().counter("lab2_splitter_chunks_total", "Confirmed chunks");
+    Counter &cache_hits =
+        Metrics::global().counter("lab2_splitter_cache_hits_total", "Chunks sent to the aggregator from the cache");
+    Counter &bytes_out = Metrics::global().counter("lab2_splitter_bytes_out_total", "Confirmed task bytes");
+};
+
+SplitterMetrics &metrics()
+{
+    static SplitterMetrics metrics;
+    return metrics;
+}
+
+struct Chunk {
+    uint64_t index = 0;
+    // 0 - общее число чанков ещё неизвестно, настоящее значение приходит в последнем чанке
+    uint64_t total = 0;
+    SentenceStore sentences;
+};
+
+// Бюджет чанка в байтах. С целевой задержкой оценивает по отзывам воркеров стоимость байта
+// (скользящее среднее) и держит бюджет таким, чтобы чанк обрабатывался примерно target секунд.
+class ChunkBudget {
+public:
+    static constexpr size_t MIN_BYTES = 4 << 10;
+    static constexpr size_t MAX_BYTES = 1 << 20;
+
+    ChunkBudget(size_t initial, double target) : current(initial), target_us(target * 1e6)
+    {
+        if (target_us > 0 && current == 0) {
+            current = 32 << 10;
+        }
+    }
+
+    [[nodiscard]] size_t bytes() const { return current; }
+    [[nodiscard]] bool adaptive() const { return target_us > 0; }
+
+    void observe(uint64_t bytes, uint64_t processing_us)
+    {
+        if (!adaptive() || bytes == 0) {
+            return;
+        }
+        double sample = static_cast<double>(std::max<uint64_t>(processing_us, 1)) / static_cast<double>(bytes);
+        us_per_byte = us_per_byte == 0 ? sample : 0.8 * us_per_byte + 0.2 * sample;
+
+        // Не больше чем вдвое за отзыв: отзывы приходят с опозданием на окно публикации
+        double wanted = target_us / us_per_byte;
+        wanted = std::clamp(wanted, current / 2.0, current * 2.0);
+        current = std::clamp(static_cast<size_t>(wanted), MIN_BYTES, MAX_BYTES);
+    }
+
+private:
+    size_t current;
+    double target_us;
+    double us_per_byte = 0;
+};
+
+// Нарезает поток предложений на чанки. Держит один готовый чанк в запасе, чтобы знать, какой из них последний.
+// Чанк закрывается по числу предложений или по бюджету в байтах - что наступит раньше.
+template <typename NextSentence>
+class ChunkSource {
+public:
+    ChunkSource(NextSentence next_sentence, size_t chunk_size, const ChunkBudget &budget)
+        : next_sentence(std::move(next_sentence)), chunk_size(chunk_size), budget(budget)
+    {
+    }
+
+    std::optional<Chunk> next()
+    {
+        if (!pending) {
+            pending = fill();
+            if (!pending) {
+                return std::nullopt;
+            }
+        }
+
+        auto following = fill();
+        Chunk chunk = std::exchange(*pending, {});
+        chunk.index = chunk_num++;
+        if (!following) {
+            chunk.total = chunk_num;
+        }
+        pending = std::move(following);
+        return chunk;
+    }
+
+    [[nodiscard]] size_t sentenceCount() const { return sentence_count; }
+
+private:
+    std::optional<Chunk> fill()
+    {
+        ScopedTimer timer(metrics().chunk);
+        Chunk chunk;
+        size_t bytes = 0;
+        size_t byte_limit = budget.bytes();
+        while ((chunk_size == 0 || chunk.sentences.size() < chunk_size) && (byte_limit == 0 || bytes < byte_limit)) {
+            auto sentence = next_sentence();
+            if (!sentence) {
+                break;
+            }
+            chunk.sentences.add(*sentence);
+            bytes += sentence->size();
+            ++sentence_count;
+        }
+        return chunk.sentences.empty() ? std::nullopt : std::optional<Chunk>(std::move(chunk));
+    }
+
+    NextSentence next_sentence;
+    size_t chunk_size;
+    const ChunkBudget &budget;
+    std::optional<Chunk> pending;
+    uint64_t chunk_num = 0;
+    size_t sentence_count = 0;
+};
+
+// Файл до мегабайта - старший приоритет, каждое удвоение размера - на ступень ниже
+uint8_t priorityBySize(const std::string &path)
+{
+    std::error_code error;
+    auto megabytes = std::filesystem::file_size(path, error) >> 20;
+    if (error) {
+        return wire::MAX_PRIORITY / 2;
+    }
+    auto steps = static_cast<int>(std::bit_width(megabytes));
+    return static_cast<uint8_t>(std::max(0, wire::MAX_PRIORITY - steps));
+}
+}
+
+SplitterOptions SplitterOptions::fromEnv(std::string path)
+{
+    SplitterOptions options;
+    options.path = std::move(path);
+    options.chunk_bytes = envSize("LAB2_CHUNK_BYTES", options.chunk_bytes);
+    options.target_latency = envDouble("LAB2_CHUNK_TARGET_MS", options.target_latency * 1000) / 1000.0;
+    // С бюджетом в байтах число предложений по умолчанию не ограничено
+    bool by_bytes = options.chunk_bytes != 0 || options.target_latency > 0;
+    options.chunk_size = envSize("LAB2_CHUNK_SIZE", by_bytes ? 0 : options.chunk_size);
+    if (!by_bytes) {
+        options.chunk_size = std::max<size_t>(1, options.chunk_size);
+    }
+    options.threads = envSize("LAB2_SPLIT_THREADS", options.threads);
+    options.window = std::max<size_t>(1, envSize("LAB2_PUBLISH_WINDOW", options.window));
+    options.chunk_store = envString("LAB2_CHUNK_STORE", "");
+    options.tenant = envString("LAB2_TENANT", "");
+    options.priority = static_cast<uint8_t>(
+        std::min<size_t>(envSize("LAB2_PRIORITY", priorityBySize(options.path)), wire::MAX_PRIORITY));
+    options.analyses = parseAnalyses(envString("LAB2_ANALYSES", "all"));
+    options.cache_dir = envString("LAB2_CACHE_DIR", "");
+    options.shards = std::max<size_t>(1, envSize("LAB2_AGG_SHARDS", options.shards));
+    options.format = wire::formatFromEnv();
+    if (!options.cache_dir.empty()) {
+        options.cache_config = resultConfigHash(WorkerOptions::fromEnv(), !options.chunk_store.empty());
+    }
+    options.compression = CompressionOptions::fromEnv();
+    return options;
+}
+
+int runSplitter(Transport &transport, const SplitterOptions &options)
+{
+    std::optional<SentenceStream> stream;
+    SentenceSplitter splitter;
+    size_t next_index = 0;
+    if (options.threads > 1) {
+        splitter.readAndSplit(options.path, options.threads);
+    } else {
+        stream.emplace(SentenceStream::fromFile(options.path));
+    }
+    auto next_sentence = [&]() -> std::optional<std::string_view> {
+        if (stream) {
+            return stream->next();
+        }
+        const auto &sentences = splitter.getSentences();
+        return next_index < sentences.size() ? std::optional<std::string_view>(sentences[next_index++]) : std::nullopt;
+    };
+    ChunkBudget budget(options.chunk_bytes, options.target_latency);
+    ChunkSource chunks(next_sentence, options.chunk_size, budget);
+
+    auto content_type = wire::contentType(options.format);
+    auto task_queue = wire::taskQueue(options.tenant);
+    uint64_t id =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    std::optional<ChunkWriter> store;
+    if (!options.chunk_store.empty()) {
+        store.emplace(options.chunk_store, id);
+    }
+    // Только диск: в памяти сплиттера кэш ни с кем не общий
+    std::optional<ResultCache> cache;
+    std::string result_queue = wire::resultQueue(wire::shardOf(id, options.shards), options.shards);
+    if (!options.cache_dir.empty()) {
+        cache.emplace(0, options.cache_dir);
+        transport.declareQueue(result_queue);
+    }
+    size_t cached = 0;
+
+    size_t in_flight = 0;
+    size_t confirmed = 0;
+    size_t published_bytes = 0;
+    // Сжатие тел задач: published_bytes - байты после него, encoded_bytes - до
+    PayloadCodec codec(options.compression);
+    size_t encoded_bytes = 0;
+    // Отзывов ждём не больше чем на окно чанков: после выхода сплиттера они остаются в очереди
+    size_t awaited_feedback = 0;
+    bool exhausted = false;
+    bool failed = false;
+    auto started = std::chrono::steady_clock::now();
+
+    std::function<void()> pump;
+    // from_cache - body уже результат чанка и уходит агрегатору, иначе это задача для воркеров
+    std::function<void(std::shared_ptr<const std::string>, std::string_view, uint64_t, bool)> publish;
+
+    publish = [&](std::shared_ptr<const std::string> body, std::string_view encoding, uint64_t chunk_num,
+                  bool from_cache) {
+        ++in_flight;
+        auto sent = std::chrono::steady_clock::now();
+        auto on_confirm = [&, body, encoding, chunk_num, from_cache, sent](Transport::Confirm result) {
+            --in_flight;
+            metrics().confirm.record(
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent).count());
+            switch (result) {
+            case Transport::Confirm::Ack:
+                ++confirmed;
+                published_bytes += body->size();
+                metrics().chunks.add();
+                metrics().bytes_out.add(body->size());
+                pump();
+                break;
+            case Transport::Confirm::Nack:
+                // Брокер не принял сообщение - публикуем его заново
+                fmt::println("Chunk {} was nacked by the broker, republishing", chunk_num);
+                publish(body, encoding, chunk_num, from_cache);
+                break;
+            case Transport::Confirm::Lost:
+                fmt::println("Chunk {} was lost: channel closed before confirmation", chunk_num);
+                if (!failed) {
+                    failed = true;
+                    transport.close();
+                }
+                break;
+            }
+        };
+        if (from_cache) {
+            transport.publishConfirmed(result_queue, *body, content_type, std::move(on_confirm), 0, encoding);
+        } else {
+            transport.publishConfirmed(task_queue, *body, content_type, std::move(on_confirm), options.priority,
+                                       encoding);
+        }
+    };
+
+    // Публикуем, пока есть место в окне; подтверждения от брокера снова вызывают pump()
+    pump = [&] {
+        while (!exhausted && !failed && in_flight < options.window) {
+            auto chunk = chunks.next();
+            if (!chunk) {
+                exhausted = true;
+                break;
+            }
+
+            if (verbose()) {
+                fmt::println("({}/{}) -> {}", chunk->index + 1,
+                             chunk->total == 0 ? "?" : std::to_string(chunk->total), chunk->sentences.size());
+            }
+            if (store) {
+                store->put(chunk->index, chunk->sentences);
+            }
+            auto sentences = chunk->sentences.views();
+            uint64_t hash = 0;
+            {
+                ScopedTimer timer(metrics().hash);
+                hash = chunkHash(sentences);
+            }
+            wire::TaskMessage task{.id = id,
+                                   .chunk = chunk->index,
+                                   .total = chunk->total,
+                                   .sent_us = wire::nowMicros(),
+                                   .compact = store.has_value(),
+                                   .hash = hash,
+                                   .priority = options.priority,
+                                   .tenant = options.tenant,
+                                   .analyses = options.analyses};
+
+            // Результат уже посчитан каким-то воркером - текст чанка никуда не отправляется
+            std::optional<std::string> result;
+            std::string body;
+            if (cache) {
+                auto key = resultCacheKey(hash, options.analyses, options.cache_config);
+                result = cache->get(key);
+                if (result) {
+                    ScopedTimer timer(metrics().encode);
+                    try {
+                        body = restampResult(*result, task, options.format);
+                    } catch (const std::exception &e) {
+                        // Битую запись удаляем, чанк уходит воркерам как обычно
+                        fmt::println("Dropping a broken cache entry for chunk {}: {}", chunk->index, e.what());
+                        cache->erase(key);
+                        result.reset();
+                    }
+                }
+            }
+            if (result) {
+                ++cached;
+                metrics().cache_hits.add();
+            } else {
+                task.feedback = budget.adaptive() && awaited_feedback < options.window;
+                awaited_feedback += task.feedback ? 1 : 0;
+                task.sentences = std::move(sentences);
+                ScopedTimer timer(metrics().encode);
+                body = wire::encode(task, options.format);
+            }
+            encoded_bytes += body.size();
+            std::string_view encoding;
+            {
+                ScopedTimer timer(metrics().compress);
+                encoding = codec.compress(body);
+            }
+            publish(std::make_shared<const std::string>(std::move(body)), encoding, chunk->index, result.has_value());
+        }
+
+        if (exhausted && in_flight == 0) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            fmt::println("Sentence count {}", chunks.sentenceCount());
+            fmt::println("Published {} chunks, {:.1f} MB in {:.2f}s: {:.1f} MB/s, {:.0f} chunks/s", confirmed,
+                         published_bytes / 1e6, seconds, published_bytes / 1e6 / seconds, confirmed / seconds);
+            if (codec.codec() != Codec::None) {
+                fmt::println("Compressed with {}: {:.1f} MB of tasks before compression ({:.0f}%)",
+                             codecName(codec.codec()), encoded_bytes / 1e6,
+                             100.0 * published_bytes / std::max<size_t>(encoded_bytes, 1));
+            }
+            if (budget.adaptive()) {
+                fmt::println("Chunk budget settled at {:.1f} KB", budget.bytes() / 1024.0);
+            }
+            if (cache) {
+                fmt::println("{} of {} chunks sent to the aggregator from the result cache", cached, confirmed);
+            }
+            transport.close();
+        }
+    };
+
+    // Под разжатые отзывы; колбэк consume берёт его по ссылке
+    std::string feedback_buffer;
+    if (budget.adaptive()) {
+        // Своя очередь у задачи: отзывы других задач сюда не попадают, после выхода она удаляется
+        auto feedback_queue = wire::feedbackQueue(id);
+        transport.declareQueue(feedback_queue, {}, 0, true);
+        transport.consume(feedback_queue, 0, [&](const Transport::Message &message) {
+            auto body = codec.decompress(message.body, message.content_encoding, feedback_buffer);
+            auto feedback = wire::decodeFeedback(body, wire::formatOf(message.content_type));
+            awaited_feedback -= awaited_feedback > 0 ? 1 : 0;
+            budget.observe(feedback.bytes, feedback.processing_us);
+            transport.ack(message.delivery_tag);
+        });
+    }
+
+    transport.declareQueue(
+        task_queue,
+        [&] {
+            fmt::println("Publishing to '{}' with priority {}", task_queue, options.priority);
+            started = std::chrono::steady_clock::now();
+            pump();
+        },
+        wire::MAX_PRIORITY);
+
+    transport.run();
+    return failed ? 1 : 0;
+}
+
+} // namespace util
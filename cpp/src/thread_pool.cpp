@@ -0,0 +1,56 @@
+#include "thread_pool.hpp"
+
+namespace util {
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    workers.reserve(threads);
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+        workers.emplace_back([this] { run(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    ready.notify_one();
+}
+
+size_t ThreadPool::size() const
+{
+    return workers.size();
+}
+
+void ThreadPool::run()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex);
+            ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+} // namespace util
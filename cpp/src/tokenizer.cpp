@@ -0,0 +1,325 @@
+#include "tokenizer.hpp"
+#include "config.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LAB2_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace util {
+namespace {
+// Заглавные кириллические буквы в UTF-8 начинаются с 0xD0, за ним 0x80-0xAF:
+//   Ѐ-Џ D0 80-8F -> ѐ-џ D1 90-9F,  А-П D0 90-9F -> а-п D0 B0-BF,  Р-Я D0 A0-AF -> р-я D1 80-8F
+// 0xD0 всегда ведущий байт, поэтому "предыдущий байт 0xD0" однозначно означает продолжение этой пары.
+constexpr unsigned char CYRILLIC_LEAD = 0xD0;
+
+bool isSpace(unsigned char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+unsigned char lowerAt(std::string_view text, size_t j)
+{
+    auto c = static_cast<unsigned char>(text[j]);
+    if (c >= 'A' && c <= 'Z') {
+        return c + 0x20;
+    }
+    if (c == CYRILLIC_LEAD) {
+        auto next = j + 1 < text.size() ? static_cast<unsigned char>(text[j + 1]) : 0;
+        return (next >= 0x80 && next <= 0x8F) || (next >= 0xA0 && next <= 0xAF) ? 0xD1 : c;
+    }
+    if (j > 0 && static_cast<unsigned char>(text[j - 1]) == CYRILLIC_LEAD) {
+        if (c >= 0x80 && c <= 0x8F) {
+            return c + 0x10;
+        }
+        if (c >= 0x90 && c <= 0x9F) {
+            return c + 0x20;
+        }
+        if (c >= 0xA0 && c <= 0xAF) {
+            return c - 0x20;
+        }
+    }
+    return c;
+}
+
+// Собирает слова по маске пробелов; общая часть скалярного и векторных ядер
+class TokenBuilder {
+public:
+    TokenBuilder(std::string_view text, std::vector<Token> &out) : text(text), out(out) {}
+
+    void byte(size_t j, bool space)
+    {
+        if (space && in_token) {
+            emit(j);
+        } else if (!space && !in_token) {
+            start = j;
+            in_token = true;
+        }
+    }
+
+    // Бит p маски - пробел ли байт base + p
+    void block(size_t base, uint32_t spaces)
+    {
+        uint32_t transitions = spaces ^ ((spaces << 1) | (in_token ? 0u : 1u));
+        while (transitions != 0) {
+            int p = std::countr_zero(transitions);
+            transitions &= transitions - 1;
+            if ((spaces >> p) & 1u) {
+                emit(base + p);
+            } else {
+                start = base + p;
+                in_token = true;
+            }
+        }
+    }
+
+    void finish()
+    {
+        if (in_token) {
+            emit(text.size());
+        }
+    }
+
+private:
+    void emit(size_t end)
+    {
+        in_token = false;
+        size_t length = end - start;
+        if (text[end - 1] == '.') {
+            --length;
+        }
+        if (length != 0) {
+            out.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(length)});
+        }
+    }
+
+    std::string_view text;
+    std::vector<Token> &out;
+    bool in_token = false;
+    size_t start = 0;
+};
+
+void scalarStep(std::string_view text, char *lower, TokenBuilder &tokens, size_t j)
+{
+    tokens.byte(j, isSpace(static_cast<unsigned char>(text[j])));
+    if (lower != nullptr) {
+        lower[j] = static_cast<char>(lowerAt(text, j));
+    }
+}
+
+void tokenizeScalar(std::string_view text, char *lower, std::vector<Token> &out)
+{
+    TokenBuilder tokens(text, out);
+    for (size_t j = 0; j < text.size(); ++j) {
+        scalarStep(text, lower, tokens, j);
+    }
+    tokens.finish();
+}
+
+#ifdef LAB2_X86_SIMD
+// Векторные ядра обрабатывают блок [i, i + W) и читают соседние байты i - 1 и i + W (для пар кириллицы),
+// поэтому первый байт и хвост короче W + 1 идут скалярно.
+
+__attribute__((target("sse4.2"))) __m128i inRange128(__m128i x, unsigned char lo, unsigned char hi)
+{
+    __m128i shifted = _mm_sub_epi8(x, _mm_set1_epi8(static_cast<char>(lo)));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(static_cast<char>(hi - lo))), shifted);
+}
+
+__attribute__((target("sse4.2"))) __m128i lower128(__m128i cur, const char *at)
+{
+    __m128i delta = _mm_and_si128(inRange128(cur, 'A', 'Z'), _mm_set1_epi8(0x20));
+    if (_mm_movemask_epi8(cur) == 0) {
+        return _mm_add_epi8(cur, delta);
+    }
+    __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i *>(at - 1));
+    __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(at + 1));
+    __m128i lead = _mm_set1_epi8(static_cast<char>(CYRILLIC_LEAD));
+
+    __m128i folds_lead = _mm_or_si128(inRange128(next, 0x80, 0x8F), inRange128(next, 0xA0, 0xAF));
+    __m128i lead_fix = _mm_and_si128(_mm_cmpeq_epi8(cur, lead), folds_lead);
+    __m128i after_lead = _mm_cmpeq_epi8(prev, lead);
+    delta = _mm_or_si128(delta, _mm_and_si128(lead_fix, _mm_set1_epi8(0x01)));
+    delta = _mm_or_si128(delta, _mm_and_si128(_mm_and_si128(after_lead, inRange128(cur, 0x80, 0x8F)),
+                                              _mm_set1_epi8(0x10)));
+    delta = _mm_or_si128(delta, _mm_and_si128(_mm_and_si128(after_lead, inRange128(cur, 0x90, 0x9F)),
+                                              _mm_set1_epi8(0x20)));
+    delta = _mm_or_si128(delta, _mm_and_si128(_mm_and_si128(after_lead, inRange128(cur, 0xA0, 0xAF)),
+                                              _mm_set1_epi8(static_cast<char>(-0x20))));
+    return _mm_add_epi8(cur, delta);
+}
+
+__attribute__((target("sse4.2"))) void tokenizeSse42(std::string_view text, char *lower, std::vector<Token> &out)
+{
+    constexpr size_t W = 16;
+    // Диапазоны пробелов для PCMPESTRM: [\t, \r] и [' ', ' ']
+    const __m128i spaces_set = _mm_setr_epi8('\t', '\r', ' ', ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const char *data = text.data();
+    TokenBuilder tokens(text, out);
+
+    size_t i = 0;
+    if (!text.empty()) {
+        scalarStep(text, lower, tokens, i++);
+    }
+    for (; i + W + 1 <= text.size(); i += W) {
+        __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i mask = _mm_cmpestrm(spaces_set, 4, cur, W, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_BIT_MASK);
+        tokens.block(i, static_cast<uint32_t>(_mm_cvtsi128_si32(mask)));
+        if (lower != nullptr) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(lower + i), lower128(cur, data + i));
+        }
+    }
+    for (; i < text.size(); ++i) {
+        scalarStep(text, lower, tokens, i);
+    }
+    tokens.finish();
+}
+
+__attribute__((target("avx2"))) __m256i inRange256(__m256i x, unsigned char lo, unsigned char hi)
+{
+    __m256i shifted = _mm256_sub_epi8(x, _mm256_set1_epi8(static_cast<char>(lo)));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(static_cast<char>(hi - lo))), shifted);
+}
+
+__attribute__((target("avx2"))) __m256i lower256(__m256i cur, const char *at)
+{
+    __m256i delta = _mm256_and_si256(inRange256(cur, 'A', 'Z'), _mm256_set1_epi8(0x20));
+    if (_mm256_movemask_epi8(cur) == 0) {
+        return _mm256_add_epi8(cur, delta);
+    }
+    __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(at - 1));
+    __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(at + 1));
+    __m256i lead = _mm256_set1_epi8(static_cast<char>(CYRILLIC_LEAD));
+
+    __m256i folds_lead = _mm256_or_si256(inRange256(next, 0x80, 0x8F), inRange256(next, 0xA0, 0xAF));
+    __m256i lead_fix = _mm256_and_si256(_mm256_cmpeq_epi8(cur, lead), folds_lead);
+    __m256i after_lead = _mm256_cmpeq_epi8(prev, lead);
+    delta = _mm256_or_si256(delta, _mm256_and_si256(lead_fix, _mm256_set1_epi8(0x01)));
+    delta = _mm256_or_si256(delta, _mm256_and_si256(_mm256_and_si256(after_lead, inRange256(cur, 0x80, 0x8F)),
+                                                    _mm256_set1_epi8(0x10)));
+    delta = _mm256_or_si256(delta, _mm256_and_si256(_mm256_and_si256(after_lead, inRange256(cur, 0x90, 0x9F)),
+                                                    _mm256_set1_epi8(0x20)));
+    delta = _mm256_or_si256(delta, _mm256_and_si256(_mm256_and_si256(after_lead, inRange256(cur, 0xA0, 0xAF)),
+                                                    _mm256_set1_epi8(static_cast<char>(-0x20))));
+    return _mm256_add_epi8(cur, delta);
+}
+
+__attribute__((target("avx2"))) void tokenizeAvx2(std::string_view text, char *lower, std::vector<Token> &out)
+{
+    constexpr size_t W = 32;
+    const char *data = text.data();
+    TokenBuilder tokens(text, out);
+
+    size_t i = 0;
+    if (!text.empty()) {
+        scalarStep(text, lower, tokens, i++);
+    }
+    for (; i + W + 1 <= text.size(); i += W) {
+        __m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(cur, _mm256_set1_epi8(' ')), inRange256(cur, '\t', '\r'));
+        tokens.block(i, static_cast<uint32_t>(_mm256_movemask_epi8(space)));
+        if (lower != nullptr) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(lower + i), lower256(cur, data + i));
+        }
+    }
+    for (; i < text.size(); ++i) {
+        scalarStep(text, lower, tokens, i);
+    }
+    tokens.finish();
+}
+#endif
+
+using Kernel = void (*)(std::string_view, char *, std::vector<Token> &);
+
+Kernel kernelFor(SimdLevel level)
+{
+#ifdef LAB2_X86_SIMD
+    switch (level) {
+    case SimdLevel::Avx2:
+        return tokenizeAvx2;
+    case SimdLevel::Sse42:
+        return tokenizeSse42;
+    case SimdLevel::Scalar:
+        break;
+    }
+#endif
+    return tokenizeScalar;
+}
+
+Kernel defaultKernel()
+{
+    static const Kernel kernel = kernelFor(simdLevel());
+    return kernel;
+}
+}
+
+SimdLevel supportedSimdLevel()
+{
+    static const SimdLevel level = [] {
+#ifdef LAB2_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return SimdLevel::Avx2;
+        }
+        if (__builtin_cpu_supports("sse4.2")) {
+            return SimdLevel::Sse42;
+        }
+#endif
+        return SimdLevel::Scalar;
+    }();
+    return level;
+}
+
+SimdLevel simdLevel()
+{
+    static const SimdLevel level = [] {
+        auto requested = envString("LAB2_SIMD", "");
+        auto supported = supportedSimdLevel();
+        if (requested == "scalar") {
+            return SimdLevel::Scalar;
+        }
+        if (requested == "sse42") {
+            return std::min(supported, SimdLevel::Sse42);
+        }
+        return supported;
+    }();
+    return level;
+}
+
+std::string_view simdName(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::Avx2:
+        return "avx2";
+    case SimdLevel::Sse42:
+        return "sse42";
+    case SimdLevel::Scalar:
+        break;
+    }
+    return "scalar";
+}
+
+void tokenize(std::string_view text, std::vector<Token> &tokens)
+{
+    defaultKernel()(text, nullptr, tokens);
+}
+
+void tokenize(std::string_view text, std::vector<Token> &tokens, SimdLevel level)
+{
+    kernelFor(std::min(level, supportedSimdLevel()))(text, nullptr, tokens);
+}
+
+void tokenizeLower(std::string_view text, char *lower, std::vector<Token> &tokens)
+{
+    defaultKernel()(text, lower, tokens);
+}
+
+void tokenizeLower(std::string_view text, char *lower, std::vector<Token> &tokens, SimdLevel level)
+{
+    kernelFor(std::min(level, supportedSimdLevel()))(text, lower, tokens);
+}
+
+} // namespace util
@@ -0,0 +1,539 @@
+#include "wire_format.hpp"
+#include "config.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+namespace util::wire {
+namespace {
+using json = nlohmann::json;
+
+class Writer {
+public:
+    explicit Writer(Kind kind)
+    {
+        out.push_back('L');
+        out.push_back('2');
+        out.push_back(static_cast<char>(VERSION));
+        out.push_back(static_cast<char>(kind));
+    }
+
+    void varint(uint64_t value)
+    {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    void svarint(int64_t value)
+    {
+        varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void bytes(std::string_view value)
+    {
+        varint(value.size());
+        out.append(value);
+    }
+
+    void strings(const std::vector<std::string_view> &values)
+    {
+        varint(values.size());
+        for (auto value : values) {
+            bytes(value);
+        }
+    }
+
+    std::string take() { return std::move(out); }
+
+private:
+    std::string out;
+};
+
+class Reader {
+public:
+    Reader(std::string_view data, Kind kind) : data(data)
+    {
+        if (peekKind(data) != kind) {
+            throw std::runtime_error("wire::Reader: unexpected message kind");
+        }
+        pos = 4;
+    }
+
+    static Kind peekKind(std::string_view data)
+    {
+        if (data.size() < 4 || data[0] != 'L' || data[1] != '2') {
+            throw std::runtime_error("wire::Reader: not a lab2 message");
+        }
+        if (static_cast<uint8_t>(data[2]) != VERSION) {
+            throw std::runtime_error("wire::Reader: unsupported version " +
+                                     std::to_string(static_cast<uint8_t>(data[2])));
+        }
+        return static_cast<Kind>(data[3]);
+    }
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= data.size()) {
+                throw std::runtime_error("wire::Reader: truncated message");
+            }
+            auto byte = static_cast<uint8_t>(data[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("wire::Reader: malformed varint");
+    }
+
+    int64_t svarint()
+    {
+        uint64_t value = varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    std::string_view bytes()
+    {
+        uint64_t size = varint();
+        if (size > data.size() - pos) {
+            throw std::runtime_error("wire::Reader: truncated message");
+        }
+        auto value = data.substr(pos, size);
+        pos += size;
+        return value;
+    }
+
+    // Размер берётся из сообщения, поэтому резервируем не больше, чем вообще может в нём поместиться
+    size_t count()
+    {
+        uint64_t size = varint();
+        if (size > data.size() - pos) {
+            throw std::runtime_error("wire::Reader: bad element count");
+        }
+        return size;
+    }
+
+    void strings(std::vector<std::string_view> &values)
+    {
+        size_t size = count();
+        values.reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            values.push_back(bytes());
+        }
+    }
+
+private:
+    std::string_view data;
+    size_t pos = 0;
+};
+
+void ownStrings(const json &array, std::vector<std::string> &owned, std::vector<std::string_view> &views)
+{
+    views.reserve(array.size());
+    for (const auto &value : array) {
+        views.push_back(owned.emplace_back(value.get<std::string>()));
+    }
+}
+
+ResultMessage resultFromJson(const json &data)
+{
+    ResultMessage message;
+    message.id = data.at("id").get<uint64_t>();
+    message.chunk = data.at("chunk").get<uint64_t>();
+    message.total = data.at("total").get<uint64_t>();
+    message.sent_us = data.value("sent_us", uint64_t(0));
+    message.started_us = data.value("started_us", uint64_t(0));
+    message.finished_us = data.value("finished_us", uint64_t(0));
+    message.cached = data.value("cached", false);
+    message.priority = data.value("priority", uint8_t(0));
+    message.analyses = data.value("analyses", uint32_t(0));
+    message.word_count = data.at("word_count").get<uint64_t>();
+
+    const auto &frequencies = data.at("word_frequencies");
+    message.compact = data.value("compact", false);
+    const json empty = json::array();
+    const auto &sorted = message.compact ? empty : data.at("sorted_sentences");
+    const auto &replaced = message.compact ? empty : data.at("sentences_with_replaced_names");
+    // +2 - арендатор и строка замены компактного результата
+    message.owned.reserve(frequencies.size() + sorted.size() + replaced.size() + 2);
+    message.tenant = message.owned.emplace_back(data.value("tenant", std::string()));
+
+    message.word_frequencies.reserve(frequencies.size());
+    for (const auto &entry : frequencies) {
+        auto &word = message.owned.emplace_back(entry.at(0).get<std::string>());
+        message.word_frequencies.emplace_back(word, entry.at(1).get<size_t>());
+    }
+
+    const auto &sentiment = data.at("sentiment");
+    message.positive = sentiment.at("positive").get<size_t>();
+    message.negative = sentiment.at("negative").get<size_t>();
+    message.score = sentiment.at("score").get<int64_t>();
+
+    if (message.compact) {
+        for (const auto &ref : data.at("sorted_order")) {
+            message.sorted_order.push_back({ref.at(0).get<uint32_t>(), ref.at(1).get<uint32_t>()});
+        }
+        for (const auto &edit : data.at("name_edits")) {
+            message.name_edits.push_back(
+                {edit.at(0).get<uint32_t>(), edit.at(1).get<uint32_t>(), edit.at(2).get<uint32_t>()});
+        }
+        message.replacement = message.owned.emplace_back(data.at("replacement").get<std::string>());
+        return message;
+    }
+    ownStrings(sorted, message.owned, message.sorted_sentences);
+    ownStrings(replaced, message.owned, message.sentences_with_replaced_names);
+    return message;
+}
+}
+
+uint64_t nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+Format formatFromEnv()
+{
+    return envString("LAB2_WIRE_FORMAT", "binary") == "json" ? Format::Json : Format::Binary;
+}
+
+std::string_view contentType(Format format)
+{
+    return format == Format::Json ? JSON_CONTENT_TYPE : BINARY_CONTENT_TYPE;
+}
+
+Format formatOf(std::string_view contentType)
+{
+    return contentType == BINARY_CONTENT_TYPE ? Format::Binary : Format::Json;
+}
+
+std::string encode(const TaskMessage &message, Format format)
+{
+    if (format == Format::Json) {
+        json mes;
+        mes["id"] = message.id;
+        mes["chunk"] = message.chunk;
+        mes["total"] = message.total;
+        mes["sent_us"] = message.sent_us;
+        mes["feedback"] = message.feedback;
+        mes["compact"] = message.compact;
+        mes["hash"] = message.hash;
+        mes["priority"] = message.priority;
+        mes["tenant"] = message.tenant;
+        mes["analyses"] = message.analyses;
+        mes["sentences"] = message.sentences;
+        return mes.dump();
+    }
+
+    Writer writer(Kind::Task);
+    writer.varint(message.id);
+    writer.varint(message.chunk);
+    writer.varint(message.total);
+    writer.varint(message.sent_us);
+    writer.varint(message.feedback ? 1 : 0);
+    writer.varint(message.compact ? 1 : 0);
+    writer.varint(message.hash);
+    writer.varint(message.priority);
+    writer.bytes(message.tenant);
+    writer.varint(message.analyses);
+    writer.strings(message.sentences);
+    return writer.take();
+}
+
+std::string encode(const ResultMessage &message, Format format)
+{
+    if (format == Format::Json) {
+        json ser;
+        ser["id"] = message.id;
+        ser["chunk"] = message.chunk;
+        ser["total"] = message.total;
+        ser["sent_us"] = message.sent_us;
+        ser["started_us"] = message.started_us;
+        ser["finished_us"] = message.finished_us;
+        ser["cached"] = message.cached;
+        ser["priority"] = message.priority;
+        ser["tenant"] = message.tenant;
+        ser["analyses"] = message.analyses;
+        ser["word_count"] = message.word_count;
+        ser["word_frequencies"] = message.word_frequencies;
+        ser["sentiment"] = {
+            {"positive", message.positive}, {"negative", message.negative}, {"score", message.score}};
+        if (message.compact) {
+            auto &order = ser["sorted_order"] = json::array();
+            for (auto ref : message.sorted_order) {
+                order.push_back({ref.index, ref.length});
+            }
+            auto &edits = ser["name_edits"] = json::array();
+            for (auto edit : message.name_edits) {
+                edits.push_back({edit.sentence, edit.offset, edit.length});
+            }
+            ser["replacement"] = message.replacement;
+            ser["compact"] = true;
+            return ser.dump();
+        }
+        ser["sentences_with_replaced_names"] = message.sentences_with_replaced_names;
+        ser["sorted_sentences"] = message.sorted_sentences;
+        return ser.dump();
+    }
+
+    Writer writer(Kind::Result);
+    writer.varint(message.id);
+    writer.varint(message.chunk);
+    writer.varint(message.total);
+    writer.varint(message.sent_us);
+    writer.varint(message.started_us);
+    writer.varint(message.finished_us);
+    writer.varint(message.cached ? 1 : 0);
+    writer.varint(message.priority);
+    writer.bytes(message.tenant);
+    writer.varint(message.analyses);
+    writer.varint(message.word_count);
+    writer.varint(message.word_frequencies.size());
+    for (const auto &[word, count] : message.word_frequencies) {
+        writer.bytes(word);
+        writer.varint(count);
+    }
+    writer.varint(message.positive);
+    writer.varint(message.negative);
+    writer.svarint(message.score);
+    writer.varint(message.compact ? 1 : 0);
+    if (message.compact) {
+        writer.varint(message.sorted_order.size());
+        for (auto ref : message.sorted_order) {
+            writer.varint(ref.index);
+            writer.varint(ref.length);
+        }
+        // Правки идут по возрастанию номера предложения - пишем разность с предыдущим
+        writer.varint(message.name_edits.size());
+        uint32_t sentence = 0;
+        for (auto edit : message.name_edits) {
+            writer.varint(edit.sentence - sentence);
+            writer.varint(edit.offset);
+            writer.varint(edit.length);
+            sentence = edit.sentence;
+        }
+        writer.bytes(message.replacement);
+        return writer.take();
+    }
+    writer.strings(message.sorted_sentences);
+    writer.strings(message.sentences_with_replaced_names);
+    return writer.take();
+}
+
+std::string encode(const FeedbackMessage &message, Format format)
+{
+    if (format == Format::Json) {
+        json mes;
+        mes["id"] = message.id;
+        mes["chunk"] = message.chunk;
+        mes["bytes"] = message.bytes;
+        mes["processing_us"] = message.processing_us;
+        return mes.dump();
+    }
+
+    Writer writer(Kind::Feedback);
+    writer.varint(message.id);
+    writer.varint(message.chunk);
+    writer.varint(message.bytes);
+    writer.varint(message.processing_us);
+    return writer.take();
+}
+
+TaskMessage decodeTask(std::string_view body, Format format)
+{
+    TaskMessage message;
+
+    if (format == Format::Json) {
+        json data(json::parse(body));
+        message.id = data["id"].get<uint64_t>();
+        message.chunk = data["chunk"].get<uint64_t>();
+        message.total = data["total"].get<uint64_t>();
+        message.sent_us = data.value("sent_us", uint64_t(0));
+        message.feedback = data.value("feedback", false);
+        message.compact = data.value("compact", false);
+        message.hash = data.value("hash", uint64_t(0));
+        message.priority = data.value("priority", uint8_t(0));
+        message.analyses = data.value("analyses", uint32_t(0));
+        // Резерв заранее: view на короткие строки (SSO) не переживут реаллокацию вектора
+        message.owned.reserve(data["sentences"].size() + 1);
+        message.tenant = message.owned.emplace_back(data.value("tenant", std::string()));
+        ownStrings(data["sentences"], message.owned, message.sentences);
+        return message;
+    }
+
+    Reader reader(body, Kind::Task);
+    message.id = reader.varint();
+    message.chunk = reader.varint();
+    message.total = reader.varint();
+    message.sent_us = reader.varint();
+    message.feedback = reader.varint() != 0;
+    message.compact = reader.varint() != 0;
+    message.hash = reader.varint();
+    message.priority = static_cast<uint8_t>(reader.varint());
+    message.tenant = reader.bytes();
+    message.analyses = static_cast<uint32_t>(reader.varint());
+    reader.strings(message.sentences);
+    return message;
+}
+
+ResultMessage decodeResult(std::string_view body, Format format)
+{
+    if (format == Format::Json) {
+        return resultFromJson(json::parse(body));
+    }
+
+    ResultMessage message;
+    Reader reader(body, Kind::Result);
+    message.id = reader.varint();
+    message.chunk = reader.varint();
+    message.total = reader.varint();
+    message.sent_us = reader.varint();
+    message.started_us = reader.varint();
+    message.finished_us = reader.varint();
+    message.cached = reader.varint() != 0;
+    message.priority = static_cast<uint8_t>(reader.varint());
+    message.tenant = reader.bytes();
+    message.analyses = static_cast<uint32_t>(reader.varint());
+    message.word_count = reader.varint();
+    size_t word_count = reader.count();
+    message.word_frequencies.reserve(word_count);
+    for (size_t i = 0; i < word_count; ++i) {
+        auto word = reader.bytes();
+        message.word_frequencies.emplace_back(word, reader.varint());
+    }
+    message.positive = reader.varint();
+    message.negative = reader.varint();
+    message.score = reader.svarint();
+    message.compact = reader.varint() != 0;
+    if (message.compact) {
+        size_t order_size = reader.count();
+        message.sorted_order.reserve(order_size);
+        for (size_t i = 0; i < order_size; ++i) {
+            auto index = static_cast<uint32_t>(reader.varint());
+            message.sorted_order.push_back({index, static_cast<uint32_t>(reader.varint())});
+        }
+        size_t edit_count = reader.count();
+        message.name_edits.reserve(edit_count);
+        uint32_t sentence = 0;
+        for (size_t i = 0; i < edit_count; ++i) {
+            sentence += static_cast<uint32_t>(reader.varint());
+            auto offset = static_cast<uint32_t>(reader.varint());
+            message.name_edits.push_back({sentence, offset, static_cast<uint32_t>(reader.varint())});
+        }
+        message.replacement = reader.bytes();
+        return message;
+    }
+    reader.strings(message.sorted_sentences);
+    reader.strings(message.sentences_with_replaced_names);
+    return message;
+}
+
+FeedbackMessage decodeFeedback(std::string_view body, Format format)
+{
+    FeedbackMessage message;
+
+    if (format == Format::Json) {
+        json data(json::parse(body));
+        message.id = data.at("id").get<uint64_t>();
+        message.chunk = data.at("chunk").get<uint64_t>();
+        message.bytes = data.at("bytes").get<uint64_t>();
+        message.processing_us = data.at("processing_us").get<uint64_t>();
+        return message;
+    }
+
+    Reader reader(body, Kind::Feedback);
+    message.id = reader.varint();
+    message.chunk = reader.varint();
+    message.bytes = reader.varint();
+    message.processing_us = reader.varint();
+    return message;
+}
+
+std::string encodeBatch(const std::vector<std::string> &results, Format format)
+{
+    if (format == Format::Json) {
+        std::string out = "[";
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (i > 0) {
+                out += ',';
+            }
+            out += results[i];
+        }
+        out += ']';
+        return out;
+    }
+
+    Writer writer(Kind::ResultBatch);
+    writer.varint(results.size());
+    for (const auto &result : results) {
+        writer.bytes(result);
+    }
+    return writer.take();
+}
+
+std::vector<ResultMessage> decodeResults(std::string_view body, Format format)
+{
+    std::vector<ResultMessage> messages;
+
+    if (format == Format::Json) {
+        json data(json::parse(body));
+        if (!data.is_array()) {
+            messages.push_back(resultFromJson(data));
+            return messages;
+        }
+        messages.reserve(data.size());
+        for (const auto &result : data) {
+            messages.push_back(resultFromJson(result));
+        }
+        return messages;
+    }
+
+    if (Reader::peekKind(body) == Kind::Result) {
+        messages.push_back(decodeResult(body, format));
+        return messages;
+    }
+
+    Reader reader(body, Kind::ResultBatch);
+    size_t size = reader.count();
+    messages.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        messages.push_back(decodeResult(reader.bytes(), format));
+    }
+    return messages;
+}
+
+size_t shardOf(uint64_t job_id, size_t shards)
+{
+    if (shards <= 1) {
+        return 0;
+    }
+    // id - время в миллисекундах, перемешиваем, чтобы соседние задачи не шли в один шард по кругу
+    return static_cast<size_t>((job_id * 0x9e3779b97f4a7c15ULL) >> 32) % shards;
+}
+
+std::string resultQueue(size_t shard, size_t shards)
+{
+    return shards <= 1 ? std::string("agg_queue") : "agg_queue." + std::to_string(shard);
+}
+
+std::string taskQueue(std::string_view tenant)
+{
+    return tenant.empty() ? std::string("task_queue") : "task_queue." + std::string(tenant);
+}
+
+std::string feedbackQueue(uint64_t job_id)
+{
+    return "chunk_feedback." + std::to_string(job_id);
+}
+
+std::vector<std::string_view> toViews(const std::vector<std::string> &strings)
+{
+    return {strings.begin(), strings.end()};
+}
+
+} // namespace util::wire
@@ -0,0 +1,106 @@
+#include "word_counter.hpp"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace util {
+namespace {
+constexpr size_t MIN_CAPACITY = 64;
+
+uint64_t hashWord(std::string_view word)
+{
+    return std::hash<std::string_view>{}(word);
+}
+}
+
+size_t WordCounter::findSlot(std::string_view word, uint64_t hash) const
+{
+    size_t mask = slots.size() - 1;
+    size_t index = hash & mask;
+
+    while (true) {
+        const Slot &slot = slots[index];
+        if (slot.count == 0) {
+            return index;
+        }
+        if (slot.hash == hash && slot.length == word.size() &&
+            std::memcmp(keys.data() + slot.offset, word.data(), word.size()) == 0) {
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+WordCounter::value_type WordCounter::entry(size_t index) const
+{
+    const Slot &slot = slots[index];
+    return {std::string_view(keys.data() + slot.offset, slot.length), slot.count};
+}
+
+void WordCounter::grow()
+{
+    std::vector<Slot> old = std::exchange(slots, std::vector<Slot>(std::max(MIN_CAPACITY, slots.size() * 2)));
+    size_t mask = slots.size() - 1;
+
+    for (const Slot &slot : old) {
+        if (slot.count == 0) {
+            continue;
+        }
+        size_t index = slot.hash & mask;
+        while (slots[index].count != 0) {
+            index = (index + 1) & mask;
+        }
+        slots[index] = slot;
+    }
+}
+
+void WordCounter::add(std::string_view word, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    // Заполненность не выше 3/4, иначе цепочки пробирования резко удлиняются
+    if ((used + 1) * 4 > slots.size() * 3) {
+        grow();
+    }
+
+    uint64_t hash = hashWord(word);
+    Slot &slot = slots[findSlot(word, hash)];
+
+    if (slot.count == 0) {
+        if (keys.size() + word.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("WordCounter::add: key arena overflow");
+        }
+        slot.hash = hash;
+        slot.offset = static_cast<uint32_t>(keys.size());
+        slot.length = static_cast<uint32_t>(word.size());
+        keys.append(word);
+        ++used;
+    }
+    slot.count += count;
+}
+
+void WordCounter::merge(const WordCounter &other)
+{
+    for (auto [word, count] : other) {
+        add(word, count);
+    }
+}
+
+size_t WordCounter::count(std::string_view word) const
+{
+    if (slots.empty()) {
+        return 0;
+    }
+    return slots[findSlot(word, hashWord(word))].count;
+}
+
+void WordCounter::clear()
+{
+    slots.clear();
+    keys.clear();
+    used = 0;
+}
+
+} // namespace util
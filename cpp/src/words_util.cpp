@@ -1,59 +1,117 @@
 #include "words_util.hpp"
-#include <regex>
+
 #include <algorithm>
+#include <array>
+#include <queue>
+#include <stdexcept>
+#include <utility>
 
 namespace util {
 namespace {
-const std::set<std::string> POSITIVE_WORDS = {
-        "good", "great", "excellent", "amazing", "wonderful", "fantastic",   "awesome", "happy",     "joy",
-        "love", "nice",  "beautiful", "perfect", "brilliant", "outstanding", "superb",  "marvelous", "delightful"};
+template <typename Sentences, size_t... Masks>
+constexpr auto passTable(std::index_sequence<Masks...>)
+{
+    return std::array{&PipelineFor<Masks>::type::template run<Sentences>...};
+}
 
-const std::set<std::string> NEGATIVE_WORDS = {
-        "bad",     "terrible", "awful",   "horrible",   "sad",  "unhappy", "hate", "worst",    "boring",
-        "dislike", "angry",    "hateful", "disgusting", "ugly", "stupid",  "dumb", "annoying", "disappointing"};
+template <typename Sentences>
+ChunkAnalysis analyze(const Sentences &sentences, unsigned analyses)
+{
+    static_assert((WORD_ANALYSES & (WORD_ANALYSES + 1)) == 0, "word stage flags must be the lowest bits");
+    static constexpr auto PASSES = passTable<Sentences>(std::make_index_sequence<WORD_ANALYSES + 1>());
+    ChunkAnalysis result;
+    PASSES[analyses & WORD_ANALYSES](sentences, result);
+    return result;
+}
 }
 
-std::vector<std::string> splitIntoWords(const std::string &text)
+std::vector<std::string> splitIntoWords(std::string_view text)
 {
+    std::vector<Token> tokens;
+    tokenize(text, tokens);
     std::vector<std::string> words;
-    std::istringstream iss(text);
-    std::string word;
+    words.reserve(tokens.size());
+    for (auto token : tokens) {
+        words.emplace_back(text.substr(token.offset, token.length));
+    }
+    return words;
+}
 
-    while (iss >> word) {
-        if (!word.empty() && word.back() == '.') {
-            word.pop_back();
-        }
+ChunkAnalysis analyzeChunk(std::span<const std::string_view> sentences, unsigned analyses)
+{
+    return analyze(sentences, analyses);
+}
 
-        if (!word.empty()) {
-            words.push_back(word);
+ChunkAnalysis analyzeChunk(const std::vector<std::string> &sentences, unsigned analyses)
+{
+    return analyze(sentences, analyses);
+}
+
+unsigned parseAnalyses(std::string_view spec)
+{
+    static constexpr std::array<std::pair<std::string_view, unsigned>, 6> NAMES_OF{{{"words", WORD_COUNT},
+                                                                                   {"frequencies", WORD_FREQUENCIES},
+                                                                                   {"sentiment", SENTIMENT},
+                                                                                   {"names", NAMES},
+                                                                                   {"sort", SORT},
+                                                                                   {"all", ALL_ANALYSES}}};
+    unsigned analyses = 0;
+    while (!spec.empty()) {
+        auto comma = spec.find(',');
+        auto name = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view() : spec.substr(comma + 1);
+        if (name.empty()) {
+            continue;
         }
+        auto it = std::find_if(NAMES_OF.begin(), NAMES_OF.end(),
+                               [&](const auto &entry) { return entry.first == name; });
+        if (it == NAMES_OF.end()) {
+            throw std::runtime_error("parseAnalyses: unknown analysis '" + std::string(name) + "'");
+        }
+        analyses |= it->second;
     }
+    return analyses;
+}
 
-    return words;
+WordCounts countWords(const std::vector<std::string> &sentences)
+{
+    return analyzeChunk(sentences, WORD_FREQUENCIES).word_frequencies;
 }
 
-std::vector<std::pair<std::string, size_t>> topNWords(const std::vector<std::string> &sentences, size_t n)
+WordCounts countWords(std::span<const std::string_view> sentences)
 {
-    std::map<std::string, size_t> word_count;
+    return analyzeChunk(sentences, WORD_FREQUENCIES).word_frequencies;
+}
 
-    for (const auto &sentence : sentences) {
-        auto words = util::splitIntoWords(sentence);
-        for (const auto &word : words) {
-            std::string lower_word = word;
-            std::transform(lower_word.begin(), lower_word.end(), lower_word.begin(), ::tolower);
-            word_count[lower_word]++;
-        }
+void mergeWordCounts(WordCounts &into, const std::vector<std::pair<std::string, size_t>> &counts)
+{
+    for (const auto &[word, count] : counts) {
+        into.add(word, count);
     }
+}
+
+std::vector<std::pair<std::string, size_t>> topN(const WordCounts &counts, size_t n)
+{
+    // При равных частотах порядок по алфавиту, чтобы результат не зависел от порядка чанков
+    auto by_count = [](const auto &a, const auto &b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    };
 
-    std::vector<std::pair<std::string, size_t>> sorted_words(word_count.begin(), word_count.end());
-    std::sort(sorted_words.begin(), sorted_words.end(),
-              [](const auto &a, const auto &b) { return a.second > b.second; });
+    std::vector<WordCounter::value_type> sorted_words(counts.begin(), counts.end());
+    n = std::min(n, sorted_words.size());
+    std::partial_sort(sorted_words.begin(), sorted_words.begin() + n, sorted_words.end(), by_count);
 
-    if (sorted_words.size() > n) {
-        sorted_words.resize(n);
-    }
+    return {sorted_words.begin(), sorted_words.begin() + n};
+}
 
-    return sorted_words;
+std::vector<std::pair<std::string, size_t>> topNWords(const std::vector<std::string> &sentences, size_t n)
+{
+    return topN(countWords(sentences), n);
+}
+
+std::vector<std::pair<std::string, size_t>> topNWords(std::span<const std::string_view> sentences, size_t n)
+{
+    return topN(countWords(sentences), n);
 }
 
 std::vector<std::string> sortSentencesByLength(const std::vector<std::string> &sentences)
@@ -65,77 +123,120 @@ std::vector<std::string> sortSentencesByLength(const std::vector<std::string> &s
     return sorted;
 }
 
+std::vector<uint32_t> sortedIndicesByLength(std::span<const std::string_view> sentences)
+{
+    std::vector<uint32_t> order(sentences.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        auto x = sentences[a].length();
+        auto y = sentences[b].length();
+        return x != y ? x > y : a < b;
+    });
+    return order;
+}
+
+std::vector<std::string_view> sortSentencesByLength(std::span<const std::string_view> sentences)
+{
+    std::vector<std::string_view> sorted;
+    sorted.reserve(sentences.size());
+    for (auto index : sortedIndicesByLength(sentences)) {
+        sorted.push_back(sentences[index]);
+    }
+    return sorted;
+}
+
 std::vector<std::string> replaceNames(const std::vector<std::string> &sentences, const std::string &replacement)
 {
+    return replaceNames(sentences, replacement, NameRules{});
+}
+
+std::vector<std::string> replaceNames(const std::vector<std::string> &sentences, const std::string &replacement,
+                                      const NameRules &rules)
+{
+    NameScanner scanner(rules);
     std::vector<std::string> result;
-    std::regex name_regex(R"(\b[A-Z][a-z]*\b)"); // Слова, начинающиеся с заглавной буквы
+    result.reserve(sentences.size());
 
     for (const auto &sentence : sentences) {
-        std::string modified = std::regex_replace(sentence, name_regex, replacement);
-        result.push_back(modified);
+        result.push_back(scanner.replace(sentence, replacement));
     }
 
     return result;
 }
 
-std::vector<std::pair<std::string, size_t>> mergeTopWords(
-        const std::vector<std::vector<std::pair<std::string, size_t>>> &all_top_words, size_t n)
+void replaceNames(std::span<const std::string_view> sentences, std::string_view replacement, const NameRules &rules,
+                  SentenceStore &out)
 {
+    NameScanner scanner(rules);
+    size_t bytes = 0;
+    for (auto sentence : sentences) {
+        bytes += sentence.size();
+    }
+    // Замена обычно не длиннее имени, небольшой запас на случай длинной замены коротких имён
+    out.reserve(out.bytes() + bytes + bytes / 8, out.size() + sentences.size());
 
-    std::map<std::string, size_t> merged_count;
-
-    for (const auto &chunk_words : all_top_words) {
-        for (const auto &[word, count] : chunk_words) {
-            merged_count[word] += count;
-        }
+    for (auto sentence : sentences) {
+        out.emplace([&](std::string &buffer) { scanner.replace(sentence, replacement, buffer); });
     }
+}
 
-    std::vector<std::pair<std::string, size_t>> merged_sorted(merged_count.begin(), merged_count.end());
-    std::sort(merged_sorted.begin(), merged_sorted.end(),
-              [](const auto &a, const auto &b) { return a.second > b.second; });
+std::vector<std::pair<std::string, size_t>> mergeTopWords(
+        const std::vector<std::vector<std::pair<std::string, size_t>>> &all_top_words, size_t n)
+{
+    // Точный результат, если на вход пришли полные таблицы частот чанков (countWords), а не их вершины
+    WordCounts merged_count;
 
-    if (merged_sorted.size() > n) {
-        merged_sorted.resize(n);
+    for (const auto &chunk_words : all_top_words) {
+        mergeWordCounts(merged_count, chunk_words);
     }
 
-    return merged_sorted;
+    return topN(merged_count, n);
 }
 
 std::vector<std::string> mergeAndSortSentences(const std::vector<std::vector<std::string>> &all_sentences)
 {
+    // Каждый чанк уже отсортирован воркером по убыванию длины - достаточно k-way слияния
+    using Head = std::pair<size_t, size_t>; // номер чанка, позиция в нём
+    auto later = [&](const Head &a, const Head &b) {
+        size_t length_a = all_sentences[a.first][a.second].length();
+        size_t length_b = all_sentences[b.first][b.second].length();
+        return length_a != length_b ? length_a < length_b : a.first > b.first;
+    };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heap(later);
+
+    size_t total = 0;
+    for (size_t chunk = 0; chunk < all_sentences.size(); ++chunk) {
+        total += all_sentences[chunk].size();
+        if (!all_sentences[chunk].empty()) {
+            heap.emplace(chunk, 0);
+        }
+    }
 
     std::vector<std::string> all_merged;
-
-    for (const auto &chunk_sentences : all_sentences) {
-        all_merged.insert(all_merged.end(), chunk_sentences.begin(), chunk_sentences.end());
+    all_merged.reserve(total);
+    while (!heap.empty()) {
+        auto [chunk, index] = heap.top();
+        heap.pop();
+        all_merged.push_back(all_sentences[chunk][index]);
+        if (index + 1 < all_sentences[chunk].size()) {
+            heap.emplace(chunk, index + 1);
+        }
     }
-
-    std::sort(all_merged.begin(), all_merged.end(),
-              [](const std::string &a, const std::string &b) { return a.length() > b.length(); });
-
     return all_merged;
 }
 
 std::pair<size_t, size_t> analyzeSentiment(const std::vector<std::string> &sentences)
 {
-    size_t positive_count = 0;
-    size_t negative_count = 0;
-
-    for (const auto &sentence : sentences) {
-        auto words = splitIntoWords(sentence);
-        for (const auto &word : words) {
-            std::string lower_word = word;
-            std::ranges::transform(lower_word, lower_word.begin(), ::tolower);
-
-            if (POSITIVE_WORDS.contains(lower_word)) {
-                positive_count++;
-            } else if (NEGATIVE_WORDS.contains(lower_word)) {
-                negative_count++;
-            }
-        }
-    }
+    auto result = analyzeChunk(sentences, SENTIMENT);
+    return {result.positive, result.negative};
+}
 
-    return {positive_count, negative_count};
+std::pair<size_t, size_t> analyzeSentiment(std::span<const std::string_view> sentences)
+{
+    auto result = analyzeChunk(sentences, SENTIMENT);
+    return {result.positive, result.negative};
 }
 
 }
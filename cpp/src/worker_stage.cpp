@@ -0,0 +1,533 @@
+#include "stages.hpp"
+#include "config.hpp"
+#include "metrics.hpp"
+#include "name_scanner.hpp"
+#include "payload_codec.hpp"
+#include "result_cache.hpp"
+#include "thread_pool.hpp"
+#include "words_util.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace util {
+namespace {
+struct WorkerMetrics {
+    Histogram &decompress =
+        Metrics::global().histogram("lab2_worker_decompress_seconds", "Decompression of a task message");
+    Histogram &parse = Metrics::global().histogram("lab2_worker_parse_seconds", "Decoding of a task message");
+    Histogram &queue_wait =
+        Metrics::global().histogram("lab2_worker_queue_wait_seconds", "From splitter publish to processing start");
+    Histogram &analyze = Metrics::global().histogram(
+        "lab2_worker_analyze_seconds", "Tokenization, word frequencies and sentiment (one fused pass)");
+    Histogram &replace_names = Metrics::global().histogram("lab2_worker_replace_names_seconds", "Name replacement");
+    Histogram &sort = Metrics::global().histogram("lab2_worker_sort_seconds", "Sorting sentences by length");
+    Histogram &serialize = Metrics::global().histogram("lab2_worker_serialize_seconds", "Encoding of a result");
+    Histogram &compress =
+        Metrics::global().histogram("lab2_worker_compress_seconds", "Compression of a batch of results");
+    Histogram &publish_delay =
+        Metrics::global().histogram("lab2_worker_publish_delay_seconds", "From result ready to batch publish");
+    Counter &messages = Metrics::global().counter("lab2_worker_messages_total", "Processed task messages");
+    Counter &bytes_in = Metrics::global().counter("lab2_worker_bytes_in_total", "Task bytes received");
+    Counter &bytes_out = Metrics::global().counter("lab2_worker_bytes_out_total", "Result bytes published");
+    Counter &cache_hits =
+        Metrics::global().counter("lab2_worker_cache_hits_total", "Chunk results taken from the cache");
+    Counter &cache_misses =
+        Metrics::global().counter("lab2_worker_cache_misses_total", "Hashed chunks that had to be analyzed");
+};
+
+WorkerMetrics &metrics()
+{
+    static WorkerMetrics metrics;
+    return metrics;
+}
+
+constexpr std::string_view REPLACEMENT = "ASSGRIM";
+
+// Тело сообщения копируется один раз: декодированные view ссылаются в него, пока задача в пуле
+struct Job {
+    std::string body;
+    wire::TaskMessage task;
+    uint64_t delivery_tag = 0;
+};
+
+// Копит результаты и публикует их пачками по числу, объёму или таймеру - по пачке на каждый шард
+// агрегаторов. Подтверждает доставки одним ack с флагом multiple до последнего тега, перед которым
+// все сообщения уже опубликованы. Пачка сжимается целиком: общие слова результатов сжимаются лучше вместе.
+// Работает только в потоке транспорта.
+class ResultBatcher {
+public:
+    ResultBatcher(Transport &transport, const WorkerOptions &options, const PayloadCodec &codec)
+        : transport(transport), codec(codec), format(options.format), shards(std::max<size_t>(options.shards, 1)),
+          max_results(std::max<size_t>(options.batch_results, 1)), max_bytes(options.batch_bytes),
+          max_delay(options.batch_delay), pending(shards)
+    {
+    }
+
+    ~ResultBatcher()
+    {
+        if (timer != 0) {
+            transport.stopTimer(timer);
+        }
+    }
+
+    void add(std::string body, uint64_t job_id, uint64_t delivery_tag)
+    {
+        if (tags.empty()) {
+            timer = transport.startTimer(max_delay, [this] {
+                timer = 0;
+                flush();
+            });
+        }
+        bytes += body.size();
+        pending[wire::shardOf(job_id, shards)].push_back(std::move(body));
+        tags.push_back(delivery_tag);
+        added.push_back(std::chrono::steady_clock::now());
+
+        if (tags.size() >= max_results || bytes >= max_bytes) {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (timer != 0) {
+            transport.stopTimer(std::exchange(timer, 0));
+        }
+        if (tags.empty()) {
+            return;
+        }
+
+        for (size_t shard = 0; shard < shards; ++shard) {
+            auto &results = pending[shard];
+            if (results.empty()) {
+                continue;
+            }
+            auto body = results.size() == 1 ? std::move(results.front()) : wire::encodeBatch(results, format);
+            std::string_view encoding;
+            {
+                ScopedTimer timer(metrics().compress);
+                encoding = codec.compress(body);
+            }
+            transport.publish(wire::resultQueue(shard, shards), body, wire::contentType(format), 0, encoding);
+            metrics().bytes_out.add(body.size());
+            results.clear();
+        }
+        auto now = std::chrono::steady_clock::now();
+        for (auto time : added) {
+            metrics().publish_delay.record(std::chrono::duration_cast<std::chrono::microseconds>(now - time).count());
+        }
+
+        // Пул обрабатывает сообщения не по порядку: ack multiple только до первой "дыры"
+        completed.insert(tags.begin(), tags.end());
+        uint64_t acked_before = acked;
+        while (!completed.empty() && *completed.begin() == acked + 1) {
+            acked = *completed.begin();
+            completed.erase(completed.begin());
+        }
+        if (acked != acked_before) {
+            transport.ack(acked, true);
+        }
+
+        tags.clear();
+        added.clear();
+        bytes = 0;
+    }
+
+private:
+    Transport &transport;
+    const PayloadCodec &codec;
+    wire::Format format;
+    size_t shards;
+    size_t max_results;
+    size_t max_bytes;
+    double max_delay;
+    uint64_t timer = 0;
+
+    std::vector<std::vector<std::string>> pending;
+    std::vector<uint64_t> tags;
+    std::vector<std::chrono::steady_clock::time_point> added;
+    size_t bytes = 0;
+    std::set<uint64_t> completed;
+    uint64_t acked = 0;
+};
+
+std::vector<wire::SentenceRef> sortedOrder(std::span<const std::string_view> sentences)
+{
+    std::vector<wire::SentenceRef> order;
+    order.reserve(sentences.size());
+    for (auto index : sortedIndicesByLength(sentences)) {
+        order.push_back({index, static_cast<uint32_t>(sentences[index].size())});
+    }
+    return order;
+}
+
+// Компактный результат: текст остаётся в ChunkStore, агрегатору уходят только ссылки и правки
+void fillCompact(wire::ResultMessage &result, const wire::TaskMessage &task, const NameRules &name_rules)
+{
+    result.compact = true;
+    if (result.analyses & NAMES) {
+        ScopedTimer timer(metrics().replace_names);
+        NameScanner scanner(name_rules);
+        std::vector<NameScanner::Span> spans;
+        for (size_t i = 0; i < task.sentences.size(); ++i) {
+            spans.clear();
+            scanner.find(task.sentences[i], spans);
+            for (auto span : spans) {
+                result.name_edits.push_back({static_cast<uint32_t>(i), span.offset, span.length});
+            }
+        }
+    }
+    result.replacement = REPLACEMENT;
+
+    if (result.analyses & SORT) {
+        ScopedTimer timer(metrics().sort);
+        result.sorted_order = sortedOrder(task.sentences);
+    }
+}
+
+std::string processTask(const wire::TaskMessage &task, const NameRules &name_rules, wire::Format format)
+{
+    wire::ResultMessage result{.id = task.id,
+                               .chunk = task.chunk,
+                               .total = task.total,
+                               .sent_us = task.sent_us,
+                               .started_us = wire::nowMicros(),
+                               .priority = task.priority,
+                               .tenant = task.tenant,
+                               .analyses = task.analyses != 0 ? task.analyses : ALL_ANALYSES};
+    if (task.sent_us != 0 && result.started_us > task.sent_us) {
+        metrics().queue_wait.record(result.started_us - task.sent_us);
+    }
+
+    ChunkAnalysis analysis;
+    {
+        ScopedTimer timer(metrics().analyze);
+        analysis = analyzeChunk(task.sentences, result.analyses);
+    }
+    result.word_count = analysis.word_count;
+    result.word_frequencies.assign(analysis.word_frequencies.begin(), analysis.word_frequencies.end());
+    result.positive = analysis.positive;
+    result.negative = analysis.negative;
+    result.score = static_cast<int64_t>(analysis.positive) - static_cast<int64_t>(analysis.negative);
+
+    if (task.compact) {
+        fillCompact(result, task, name_rules);
+        result.finished_us = wire::nowMicros();
+        ScopedTimer timer(metrics().serialize);
+        return wire::encode(result, format);
+    }
+
+    // Заменённые предложения - в одном буфере, отсортированные - view в тело задачи
+    SentenceStore replaced;
+    if (result.analyses & NAMES) {
+        ScopedTimer timer(metrics().replace_names);
+        replaceNames(task.sentences, REPLACEMENT, name_rules, replaced);
+    }
+    result.sentences_with_replaced_names = replaced.views();
+
+    if (result.analyses & SORT) {
+        ScopedTimer timer(metrics().sort);
+        result.sorted_sentences = sortSentencesByLength(task.sentences);
+    }
+
+    result.finished_us = wire::nowMicros();
+    ScopedTimer timer(metrics().serialize);
+    return wire::encode(result, format);
+}
+
+// Делит потоки между очередями арендаторов пропорционально весам (stride scheduling): берётся непустая очередь
+// с наименьшим проходом, и её проход растёт на STRIDE / вес. Внутри очереди - по приоритету, при равном - по
+// порядку прихода. Только поток транспорта.
+class FairScheduler {
+public:
+    explicit FairScheduler(const std::vector<std::pair<std::string, size_t>> &tenants)
+    {
+        for (const auto &[tenant, weight] : tenants) {
+            flows.push_back(Flow{.stride = STRIDE / std::max<size_t>(weight, 1)});
+        }
+    }
+
+    void push(size_t flow, std::shared_ptr<Job> job)
+    {
+        auto &target = flows[flow];
+        // Простаивавшая очередь не копит право на внеочередной захват потоков
+        if (target.jobs.empty()) {
+            target.pass = std::max(target.pass, now);
+        }
+        uint8_t priority = job->task.priority;
+        target.jobs.push({priority, sequence++, std::move(job)});
+        ++pending;
+    }
+
+    std::shared_ptr<Job> pop()
+    {
+        Flow *next = nullptr;
+        for (auto &flow : flows) {
+            if (!flow.jobs.empty() && (next == nullptr || flow.pass < next->pass)) {
+                next = &flow;
+            }
+        }
+        if (next == nullptr) {
+            return nullptr;
+        }
+        now = next->pass;
+        next->pass += next->stride;
+        auto job = next->jobs.top().job;
+        next->jobs.pop();
+        --pending;
+        return job;
+    }
+
+    [[nodiscard]] bool empty() const { return pending == 0; }
+
+private:
+    static constexpr uint64_t STRIDE = 1 << 20;
+
+    struct Entry {
+        uint8_t priority;
+        uint64_t sequence;
+        std::shared_ptr<Job> job;
+    };
+    struct Later {
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            return a.priority != b.priority ? a.priority < b.priority : a.sequence > b.sequence;
+        }
+    };
+    struct Flow {
+        uint64_t stride = STRIDE;
+        uint64_t pass = 0;
+        std::priority_queue<Entry, std::vector<Entry>, Later> jobs;
+    };
+
+    std::vector<Flow> flows;
+    uint64_t now = 0;
+    uint64_t sequence = 0;
+    size_t pending = 0;
+};
+
+// LAB2_TENANTS=default:1,alice:3 - имя[:вес] через запятую, default - общая очередь
+std::vector<std::pair<std::string, size_t>> parseTenants(const std::string &spec)
+{
+    std::vector<std::pair<std::string, size_t>> tenants;
+    size_t begin = 0;
+    while (begin <= spec.size()) {
+        size_t end = std::min(spec.find(',', begin), spec.size());
+        std::string item = spec.substr(begin, end - begin);
+        begin = end + 1;
+        if (item.empty()) {
+            continue;
+        }
+        size_t colon = item.find(':');
+        std::string name = item.substr(0, colon);
+        size_t weight = 1;
+        if (colon != std::string::npos) {
+            try {
+                weight = std::stoull(item.substr(colon + 1));
+            } catch (const std::exception &) {
+                throw std::runtime_error("parseTenants: bad weight in " + item);
+            }
+        }
+        tenants.emplace_back(name == "default" ? "" : name, std::max<size_t>(weight, 1));
+    }
+    if (tenants.empty()) {
+        tenants.emplace_back("", 1);
+    }
+    return tenants;
+}
+}
+
+uint64_t resultConfigHash(const WorkerOptions &options, bool compact)
+{
+    uint64_t gazetteer = 0;
+    if (!options.gazetteer.empty()) {
+        std::ifstream in(options.gazetteer, std::ios::binary);
+        std::ostringstream text;
+        text << in.rdbuf();
+        gazetteer = bytesHash(text.str());
+    }
+    return bytesHash(fmt::format("{}|{}|{}|{}|{}|{}", wire::VERSION, static_cast<int>(options.format),
+                                 options.skip_sentence_initial, gazetteer, REPLACEMENT, compact ? 1 : 0));
+}
+
+uint64_t resultCacheKey(uint64_t chunk_hash, uint32_t analyses, uint64_t config_hash)
+{
+    return cacheKey(chunk_hash, cacheKey(analyses != 0 ? analyses : ALL_ANALYSES, config_hash));
+}
+
+std::string restampResult(std::string_view cached, const wire::TaskMessage &task, wire::Format format)
+{
+    auto result = wire::decodeResult(cached, format);
+    result.id = task.id;
+    result.chunk = task.chunk;
+    result.total = task.total;
+    result.sent_us = task.sent_us;
+    result.started_us = wire::nowMicros();
+    result.finished_us = result.started_us;
+    result.cached = true;
+    result.priority = task.priority;
+    result.tenant = task.tenant;
+    return wire::encode(result, format);
+}
+
+WorkerOptions WorkerOptions::fromEnv()
+{
+    WorkerOptions options;
+    options.threads = envSize("LAB2_WORKER_THREADS", std::max(1u, std::thread::hardware_concurrency()));
+    options.batch_results = envSize("LAB2_RESULT_BATCH", options.batch_results);
+    options.batch_bytes = envSize("LAB2_RESULT_BATCH_BYTES", options.batch_bytes);
+    options.batch_delay = envDouble("LAB2_RESULT_BATCH_MS", options.batch_delay * 1000) / 1000.0;
+    // Сообщений на руках больше, чем потоков и размера пачки, иначе пачка всегда уходит по таймеру
+    options.prefetch = envSize("LAB2_PREFETCH", std::max(options.threads, options.batch_results) * 2);
+    options.shards = std::max<size_t>(1, envSize("LAB2_AGG_SHARDS", 1));
+    options.skip_sentence_initial = envSize("LAB2_NAME_SKIP_INITIAL", 0) != 0;
+    options.gazetteer = envString("LAB2_NAME_GAZETTEER", "");
+    options.tenants = parseTenants(envString("LAB2_TENANTS", "default"));
+    options.cache_bytes = envSize("LAB2_CACHE_MB", options.cache_bytes >> 20) << 20;
+    options.cache_dir = envString("LAB2_CACHE_DIR", "");
+    options.format = wire::formatFromEnv();
+    options.compression = CompressionOptions::fromEnv();
+    return options;
+}
+
+void runWorker(Transport &transport, const WorkerOptions &options)
+{
+    Gazetteer gazetteer;
+    NameRules name_rules{.skip_sentence_initial = options.skip_sentence_initial};
+    if (!options.gazetteer.empty()) {
+        gazetteer = Gazetteer::load(options.gazetteer);
+        name_rules.gazetteer = &gazetteer;
+        fmt::println("Loaded {} names from {}", gazetteer.size(), options.gazetteer);
+    }
+
+    std::optional<ResultCache> cache;
+    // Индекс - task.compact
+    std::array<uint64_t, 2> cache_config{};
+    if (options.cache_bytes != 0 || !options.cache_dir.empty()) {
+        cache.emplace(options.cache_bytes, options.cache_dir);
+        cache_config = {resultConfigHash(options, false), resultConfigHash(options, true)};
+    }
+
+    PayloadCodec codec(options.compression);
+    ResultBatcher batcher(transport, options, codec);
+    // Пул объявлен после batcher: при выходе сначала дожидаемся потоков, которые публикуют через него
+    ThreadPool pool(options.threads);
+
+    for (const auto &[tenant, weight] : options.tenants) {
+        auto ready = [&, queue = wire::taskQueue(tenant), weight] {
+            fmt::println("Waiting for messages in '{}' (weight {}) with {} threads, prefetch {}. To exit press CTRL+C",
+                         queue, weight, options.threads, options.prefetch);
+        };
+        transport.declareQueue(wire::taskQueue(tenant), ready, wire::MAX_PRIORITY);
+    }
+    for (size_t shard = 0; shard < options.shards; ++shard) {
+        transport.declareQueue(wire::resultQueue(shard, options.shards));
+    }
+
+    auto process = [&](const std::shared_ptr<Job> &job) {
+        uint64_t started_us = wire::nowMicros();
+        const auto &task = job->task;
+        std::string result;
+        std::optional<uint64_t> key;
+        if (cache && task.hash != 0) {
+            key = resultCacheKey(task.hash, task.analyses, cache_config[task.compact ? 1 : 0]);
+            if (auto cached = cache->get(*key)) {
+                try {
+                    result = restampResult(*cached, task, options.format);
+                } catch (const std::exception &e) {
+                    // Битая запись (чужая версия, обрыв записи) - считаем промахом и перезаписываем
+                    fmt::println("Dropping a broken cache entry for chunk {}: {}", task.chunk, e.what());
+                    cache->erase(*key);
+                }
+            }
+            if (!result.empty()) {
+                metrics().cache_hits.add();
+            } else {
+                metrics().cache_misses.add();
+            }
+        }
+        if (result.empty()) {
+            result = processTask(task, name_rules, options.format);
+            if (key) {
+                cache->put(*key, result);
+            }
+        }
+
+        // Отзыв сплиттеру для подбора размера чанков уходит сразу, не дожидаясь пачки результатов
+        std::string feedback;
+        if (task.feedback) {
+            wire::FeedbackMessage message{
+                .id = task.id, .chunk = task.chunk, .processing_us = wire::nowMicros() - started_us};
+            for (auto sentence : task.sentences) {
+                message.bytes += sentence.size();
+            }
+            feedback = wire::encode(message, options.format);
+        }
+        return std::make_pair(std::move(result), std::move(feedback));
+    };
+
+    // Потоков занято не больше, чем их есть: остальные задачи ждут в планировщике, где решается, чья очередь
+    FairScheduler scheduler(options.tenants);
+    size_t running = 0;
+    std::function<void()> dispatch = [&] {
+        while (running < pool.size() && !scheduler.empty()) {
+            ++running;
+            pool.submit([&, job = scheduler.pop()] {
+                auto done = std::make_shared<std::pair<std::string, std::string>>(process(job));
+
+                // Публикация и ack - в потоке транспорта, ack строго после публикации пачки с результатом
+                transport.post([&, done, id = job->task.id, tag = job->delivery_tag] {
+                    if (!done->second.empty()) {
+                        transport.publish(wire::feedbackQueue(id), done->second, wire::contentType(options.format));
+                    }
+                    batcher.add(std::move(done->first), id, tag);
+                    --running;
+                    dispatch();
+                });
+            });
+        }
+    };
+
+    // Под разжатые задачи; тело всё равно копируется в Job, так что буфер один на все
+    std::string payload;
+    for (size_t flow = 0; flow < options.tenants.size(); ++flow) {
+        auto queue = wire::taskQueue(options.tenants[flow].first);
+        transport.consume(queue, options.prefetch, [&, flow](const Transport::Message &message) {
+            auto job = std::make_shared<Job>();
+            {
+                ScopedTimer timer(metrics().decompress);
+                job->body.assign(codec.decompress(message.body, message.content_encoding, payload));
+            }
+            {
+                ScopedTimer timer(metrics().parse);
+                job->task = wire::decodeTask(job->body, wire::formatOf(message.content_type));
+            }
+            job->delivery_tag = message.delivery_tag;
+            metrics().messages.add();
+            metrics().bytes_in.add(message.body.size());
+            if (verbose()) {
+                fmt::println("Got ID={} ({}/{}) {} from {}, priority {}", job->task.id, job->task.chunk,
+                             job->task.total, job->task.sentences.size(), queue, job->task.priority);
+            }
+            scheduler.push(flow, std::move(job));
+            dispatch();
+        });
+    }
+    transport.run();
+}
+
+} // namespace util
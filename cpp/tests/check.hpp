@@ -0,0 +1,28 @@
+#ifndef PARL_LAB2_TESTS_CHECK_HPP
+#define PARL_LAB2_TESTS_CHECK_HPP
+
+#include <source_location>
+#include <string_view>
+
+#include <fmt/format.h>
+
+// Проверки без фреймворка: провал печатается с местом в коде, код выхода теста - число провалов
+namespace check {
+inline int failures = 0;
+
+inline void that(bool ok, std::string_view what, std::source_location where = std::source_location::current())
+{
+    if (!ok) {
+        ++failures;
+        fmt::println("FAILED {}:{}: {}", where.file_name(), where.line(), what);
+    }
+}
+
+inline int finish(std::string_view name)
+{
+    fmt::println("{}: {}", name, failures == 0 ? "ok" : fmt::format("{} checks failed", failures));
+    return failures == 0 ? 0 : 1;
+}
+} // namespace check
+
+#endif //PARL_LAB2_TESTS_CHECK_HPP
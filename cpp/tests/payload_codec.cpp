@@ -0,0 +1,144 @@
+// Сжатие тел сообщений: всё сжатое разжимается в исходные байты, короткие тела не трогаются,
+// испорченные кадры отвергаются исключением, а не мусором на выходе
+#include "check.hpp"
+#include "payload_codec.hpp"
+#include "sentence_splitter.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace util;
+
+namespace {
+// Тела по chunk_size предложений подряд - похожи на тексты задач
+std::vector<std::string> makeBodies(const SentenceStore &all, size_t first, size_t last, size_t chunk_size)
+{
+    std::vector<std::string> bodies;
+    for (size_t i = first; i < last; i += chunk_size) {
+        std::string body;
+        for (size_t j = i; j < std::min(last, i + chunk_size); ++j) {
+            body.append(all[j]).push_back('\n');
+        }
+        bodies.push_back(std::move(body));
+    }
+    return bodies;
+}
+
+template <typename Action>
+bool throws(Action &&action)
+{
+    try {
+        action();
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+void roundTrip(std::string_view name, const CompressionOptions &options, const std::vector<std::string> &bodies)
+{
+    PayloadCodec codec(options);
+    std::string buffer;
+    size_t raw = 0;
+    size_t wire = 0;
+    size_t compressed = 0;
+    bool same = true;
+    for (const auto &body : bodies) {
+        std::string message = body;
+        auto encoding = codec.compress(message);
+        if (!encoding.empty()) {
+            ++compressed;
+            same = same && encoding == codecName(options.codec) && message.size() < body.size();
+        }
+        same = same && codec.decompress(message, encoding, buffer) == body;
+        raw += body.size();
+        wire += message.size();
+    }
+    check::that(same, fmt::format("{}: round trip", name));
+    check::that(compressed == bodies.size(), fmt::format("{}: {} of {} bodies compressed", name, compressed,
+                                                         bodies.size()));
+    check::that(wire < raw, fmt::format("{}: {} -> {} bytes", name, raw, wire));
+}
+
+void corrupted(std::string_view name, const CompressionOptions &options, const std::string &body)
+{
+    PayloadCodec codec(options);
+    std::string message = body;
+    auto encoding = std::string(codec.compress(message));
+    std::string buffer;
+    check::that(!encoding.empty(), fmt::format("{}: body is compressed", name));
+
+    auto truncated = message.substr(0, message.size() / 2);
+    check::that(throws([&] { codec.decompress(truncated, encoding, buffer); }),
+                fmt::format("{}: truncated payload is rejected", name));
+    check::that(throws([&] { codec.decompress("", encoding, buffer); }),
+                fmt::format("{}: empty payload is rejected", name));
+    auto garbage = message;
+    for (size_t i = 0; i < garbage.size(); i += 3) {
+        garbage[i] = static_cast<char>(garbage[i] ^ 0x5a);
+    }
+    check::that(throws([&] {
+                    if (codec.decompress(garbage, encoding, buffer) != body) {
+                        throw std::runtime_error("mismatch");
+                    }
+                }),
+                fmt::format("{}: damaged payload is not accepted as the original", name));
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::string corpus = argc > 1 ? argv[1] : "moby_dick.txt";
+    SentenceSplitter splitter;
+    if (!splitter.readAndSplit(corpus)) {
+        fmt::println("Cannot read {}", corpus);
+        return 1;
+    }
+    const auto &all = splitter.getSentences();
+    size_t half = all.size() / 2;
+    // Словарь учится на первой половине, проверяется на второй
+    auto bodies = makeBodies(all, half, all.size(), 200);
+
+    roundTrip("lz4", {.codec = Codec::Lz4, .min_bytes = 0}, bodies);
+    roundTrip("zstd", {.codec = Codec::Zstd, .min_bytes = 0, .level = 3}, bodies);
+
+    auto dictionary_path = (std::filesystem::temp_directory_path() / "lab2_test.zdict").string();
+    std::ofstream(dictionary_path, std::ios::binary) << trainDictionary(makeBodies(all, 0, half, 20), 64 << 10);
+    CompressionOptions with_dictionary{.codec = Codec::Zstd, .min_bytes = 0, .level = 3,
+                                       .dictionary = dictionary_path};
+    roundTrip("zstd+dict", with_dictionary, bodies);
+    {
+        // Кадр со словарём без словаря не разжимается
+        PayloadCodec codec(with_dictionary);
+        PayloadCodec plain({.codec = Codec::Zstd, .min_bytes = 0});
+        std::string message = bodies.front();
+        auto encoding = std::string(codec.compress(message));
+        std::string buffer;
+        check::that(throws([&] { plain.decompress(message, encoding, buffer); }),
+                    "zstd+dict: frame needs the dictionary");
+    }
+    check::that(throws([&] { PayloadCodec codec({.codec = Codec::Zstd, .dictionary = dictionary_path + ".none"}); }),
+                "missing dictionary file is an error");
+    std::filesystem::remove(dictionary_path);
+
+    // Короче min_bytes - без сжатия, тело не меняется
+    {
+        PayloadCodec codec({.codec = Codec::Zstd, .min_bytes = 1024});
+        std::string message = "short body";
+        check::that(codec.compress(message).empty() && message == "short body", "short body is left as is");
+        PayloadCodec none({.codec = Codec::None, .min_bytes = 0});
+        message = bodies.front();
+        check::that(none.compress(message).empty() && message == bodies.front(), "codec none does not compress");
+        std::string buffer;
+        check::that(codec.decompress(message, "", buffer) == bodies.front(), "empty encoding passes through");
+        check::that(throws([&] { codec.decompress(message, "brotli", buffer); }), "unknown encoding is an error");
+    }
+
+    corrupted("lz4", {.codec = Codec::Lz4, .min_bytes = 0}, bodies.front());
+    corrupted("zstd", {.codec = Codec::Zstd, .min_bytes = 0}, bodies.front());
+    return check::finish("payload_codec");
+}
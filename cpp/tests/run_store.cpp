@@ -0,0 +1,110 @@
+// Слияние прогонов RunStore: порядок выдачи один и тот же со сбросами на диск и без них
+#include "check.hpp"
+#include "run_store.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace util;
+namespace fs = std::filesystem;
+
+namespace {
+struct Run {
+    uint64_t id;
+    std::vector<std::string> sentences;
+};
+
+// Прогоны с большим числом равных длин: длина - из восьми значений, текст помечен прогоном и позицией,
+// чтобы по выдаче был виден порядок равных
+std::vector<Run> makeRuns(size_t count, size_t size)
+{
+    std::vector<Run> runs;
+    uint64_t state = 12345;
+    for (size_t r = 0; r < count; ++r) {
+        Run run{.id = (r * 7) % count, .sentences = {}};
+        for (size_t i = 0; i < size; ++i) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            size_t length = 20 + (state >> 61) * 10;
+            auto text = fmt::format("{}:{}:", run.id, i);
+            run.sentences.push_back(text + std::string(length - text.size(), 'x'));
+        }
+        std::stable_sort(run.sentences.begin(), run.sentences.end(),
+                         [](const auto &a, const auto &b) { return a.size() > b.size(); });
+        runs.push_back(std::move(run));
+    }
+    return runs;
+}
+
+std::vector<std::string> collect(RunStore::Order order, const std::vector<Run> &runs, const fs::path &dir,
+                                 size_t memory_limit, size_t &spilled)
+{
+    std::vector<std::string> out;
+    RunStore store(order, dir.string(), memory_limit);
+    for (const auto &run : runs) {
+        store.add(run.id, run.sentences);
+    }
+    spilled = store.spilledBytes();
+    store.forEach([&](std::string_view sentence) {
+        out.emplace_back(sentence);
+        return true;
+    });
+    return out;
+}
+}
+
+int main()
+{
+    auto dir = fs::temp_directory_path() / "lab2-test-run-store";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    // Прогоны добавляются не по порядку номеров: 0, 7, 14, ...
+    auto runs = makeRuns(40, 50);
+    std::vector<const Run *> by_id;
+    for (const auto &run : runs) {
+        by_id.push_back(&run);
+    }
+    std::sort(by_id.begin(), by_id.end(), [](const Run *a, const Run *b) { return a->id < b->id; });
+
+    // Ожидаемое: по убыванию длины, равные - по номеру прогона, затем по позиции в нём
+    std::vector<std::string> by_length;
+    for (const auto *run : by_id) {
+        by_length.insert(by_length.end(), run->sentences.begin(), run->sentences.end());
+    }
+    std::stable_sort(by_length.begin(), by_length.end(),
+                     [](const auto &a, const auto &b) { return a.size() > b.size(); });
+    std::vector<std::string> concatenated;
+    for (const auto *run : by_id) {
+        concatenated.insert(concatenated.end(), run->sentences.begin(), run->sentences.end());
+    }
+
+    // Без лимита, со сбросом каждые несколько прогонов и со сбросом после каждого прогона
+    for (size_t memory_limit : {size_t{1} << 30, size_t{16} << 10, size_t{1}}) {
+        size_t spilled = 0;
+        auto merged = collect(RunStore::Order::ByLength, runs, dir, memory_limit, spilled);
+        check::that(memory_limit > (1 << 20) || spilled > 0, fmt::format("limit {}: runs spilled", memory_limit));
+        check::that(merged == by_length, fmt::format("limit {}: merged by length, ties by run and position",
+                                                     memory_limit));
+
+        auto joined = collect(RunStore::Order::ByRunId, runs, dir, memory_limit, spilled);
+        check::that(memory_limit > (1 << 20) || spilled > 0, fmt::format("limit {}: runs spilled", memory_limit));
+        check::that(joined == concatenated, fmt::format("limit {}: concatenated by run id", memory_limit));
+    }
+
+    // Остановка выдачи по false из callback
+    {
+        RunStore store(RunStore::Order::ByLength, dir.string(), 1);
+        for (const auto &run : runs) {
+            store.add(run.id, run.sentences);
+        }
+        size_t seen = 0;
+        store.forEach([&](std::string_view) { return ++seen < 10; });
+        check::that(seen == 10, "forEach stops when the callback returns false");
+    }
+
+    check::that(fs::is_empty(dir), "spill files are removed with the store");
+    fs::remove_all(dir);
+    return check::finish("run_store");
+}
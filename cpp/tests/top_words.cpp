@@ -0,0 +1,149 @@
+// Точный top-N: конвейер в одном процессе (сплиттер, два воркера, агрегатор на InProcBroker) должен дать
+// те же слова и числа, что подсчёт по всему файлу сразу, при любых границах чанков. Прогон с крошечными
+// очередями и отзывами о времени чанков проверяет, что циклы между стадиями не запирают конвейер.
+#include "check.hpp"
+#include "inproc_transport.hpp"
+#include "sentence_splitter.hpp"
+#include "stages.hpp"
+#include "words_util.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using namespace util;
+namespace fs = std::filesystem;
+
+namespace {
+constexpr size_t TOP_N = 25;
+constexpr size_t WORKERS = 2;
+
+struct Setup {
+    size_t chunk_size;
+    size_t queue_capacity = 4096;
+    // > 0 - сплиттер просит у воркеров отзывы о времени чанков
+    double target_latency = 0;
+    // Общий дисковый кэш результатов сплиттера и воркеров
+    std::string cache_dir;
+};
+
+// Итоговая строка NDJSON, которую агрегатор записал для единственной задачи
+nlohmann::json runPipeline(const std::string &corpus, const Setup &setup, const fs::path &output_dir)
+{
+    SplitterOptions splitter_options;
+    splitter_options.path = corpus;
+    splitter_options.chunk_size = setup.chunk_size;
+    splitter_options.target_latency = setup.target_latency;
+
+    WorkerOptions worker_options;
+    worker_options.cache_bytes = 0;
+    worker_options.cache_dir = setup.cache_dir;
+    if (!setup.cache_dir.empty()) {
+        splitter_options.cache_dir = setup.cache_dir;
+        splitter_options.cache_config = resultConfigHash(worker_options, false);
+    }
+
+    AggregatorOptions aggregator_options;
+    aggregator_options.top_n = TOP_N;
+    aggregator_options.spill_dir = output_dir.string();
+    aggregator_options.sink_format = ResultSink::Format::NdJson;
+    aggregator_options.output_dir = output_dir.string();
+    aggregator_options.progress_interval = 0;
+    aggregator_options.exit_after = 1;
+
+    InProcBroker broker(setup.queue_capacity);
+    InProcTransport aggregator_transport(broker);
+    std::thread aggregator([&] { runAggregator(aggregator_transport, aggregator_options); });
+    std::vector<std::unique_ptr<InProcTransport>> worker_transports;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < WORKERS; ++i) {
+        auto &transport = *worker_transports.emplace_back(std::make_unique<InProcTransport>(broker));
+        workers.emplace_back([&] { runWorker(transport, worker_options); });
+    }
+    InProcTransport splitter_transport(broker);
+    check::that(runSplitter(splitter_transport, splitter_options) == 0, "splitter exit code");
+
+    aggregator.join();
+    for (auto &transport : worker_transports) {
+        transport->close();
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    for (const auto &entry : fs::directory_iterator(output_dir)) {
+        if (entry.path().extension() == ".ndjson") {
+            std::ifstream in(entry.path());
+            std::string line;
+            std::getline(in, line);
+            return nlohmann::json::parse(line);
+        }
+    }
+    return {};
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::string corpus = argc > 1 ? argv[1] : "moby_dick.txt";
+    SentenceSplitter splitter;
+    if (!splitter.readAndSplit(corpus)) {
+        fmt::println("Cannot read {}", corpus);
+        return 1;
+    }
+    auto sentences = splitter.getSentences().views();
+    auto counts = countWords(sentences);
+    auto expected = topN(counts, TOP_N);
+    uint64_t expected_words = 0;
+    for (const auto &[word, count] : counts) {
+        expected_words += count;
+    }
+
+    // Кэш: первый прогон заполняет его, перед вторым записи портятся (как при обрыве записи), третий
+    // берёт результаты из восстановленного кэша
+    auto cache_dir = (fs::temp_directory_path() / "lab2-test-top-words-cache").string();
+    fs::remove_all(cache_dir);
+    std::vector<Setup> setups = {{.chunk_size = 1},
+                                 {.chunk_size = 7},
+                                 {.chunk_size = 50},
+                                 {.chunk_size = 1000},
+                                 {.chunk_size = 50, .queue_capacity = 2, .target_latency = 0.001},
+                                 {.chunk_size = 200, .cache_dir = cache_dir},
+                                 {.chunk_size = 200, .cache_dir = cache_dir},
+                                 {.chunk_size = 200, .cache_dir = cache_dir}};
+    size_t cache_runs = 0;
+    for (const auto &setup : setups) {
+        if (!setup.cache_dir.empty() && ++cache_runs == 2) {
+            for (const auto &entry : fs::directory_iterator(setup.cache_dir)) {
+                fs::resize_file(entry.path(), entry.file_size() / 2);
+            }
+        }
+        auto name = fmt::format("chunk {}, queue {}{}{}", setup.chunk_size, setup.queue_capacity,
+                                setup.target_latency > 0 ? ", feedback" : "",
+                                setup.cache_dir.empty() ? "" : fmt::format(", cache run {}", cache_runs));
+        auto output_dir = fs::temp_directory_path() / "lab2-test-top-words";
+        fs::remove_all(output_dir);
+        fs::create_directories(output_dir);
+
+        auto summary = runPipeline(corpus, setup, output_dir);
+        check::that(summary.value("type", "") == "summary", fmt::format("{}: summary line", name));
+        if (summary.is_object()) {
+            std::vector<std::pair<std::string, size_t>> top;
+            for (const auto &item : summary["top_words"]) {
+                top.emplace_back(item["word"].get<std::string>(), item["count"].get<size_t>());
+            }
+            check::that(top == expected, fmt::format("{}: merged top {} matches the exact count", name, TOP_N));
+            check::that(summary["sentences"].get<size_t>() == sentences.size(),
+                        fmt::format("{}: sentence count", name));
+            check::that(summary["total_words"].get<uint64_t>() == expected_words,
+                        fmt::format("{}: total words", name));
+        }
+        fs::remove_all(output_dir);
+    }
+    fs::remove_all(cache_dir);
+    return check::finish("top_words");
+}
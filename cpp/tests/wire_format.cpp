@@ -0,0 +1,186 @@
+// Кодирование и декодирование сообщений конвейера в обоих форматах должно возвращать те же поля
+#include "check.hpp"
+#include "wire_format.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace util;
+using namespace util::wire;
+
+namespace {
+std::string_view formatName(Format format)
+{
+    return format == Format::Binary ? "binary" : "json";
+}
+
+// Строки с кавычками, экранированием и нулевым байтом: JSON их экранирует, бинарный формат хранит как есть
+const std::vector<std::string> SENTENCES = {"Call me Ishmael.", "He said \"no\"\\ and left.",
+                                            std::string("zero\0byte", 9), "", "Ахав и белый кит."};
+
+void taskRoundTrip(Format format)
+{
+    TaskMessage task{.id = 1ull << 40,
+                     .chunk = 17,
+                     .total = 300,
+                     .sent_us = nowMicros(),
+                     .feedback = true,
+                     .compact = true,
+                     .hash = 0xdeadbeefcafef00dull,
+                     .priority = MAX_PRIORITY,
+                     .tenant = "tenant-a",
+                     .analyses = 5,
+                     .sentences = toViews(SENTENCES)};
+    auto body = encode(task, format);
+    auto decoded = decodeTask(body, format);
+    auto name = formatName(format);
+    check::that(decoded.id == task.id && decoded.chunk == task.chunk && decoded.total == task.total,
+                fmt::format("{}: task ids", name));
+    check::that(decoded.sent_us == task.sent_us, fmt::format("{}: task timestamp", name));
+    check::that(decoded.feedback && decoded.compact, fmt::format("{}: task flags", name));
+    check::that(decoded.hash == task.hash, fmt::format("{}: task hash", name));
+    check::that(decoded.priority == task.priority && decoded.tenant == task.tenant,
+                fmt::format("{}: task priority and tenant", name));
+    check::that(decoded.analyses == task.analyses, fmt::format("{}: task analyses", name));
+    check::that(decoded.sentences == task.sentences, fmt::format("{}: task sentences", name));
+}
+
+ResultMessage makeResult(bool compact)
+{
+    ResultMessage result{.id = 42,
+                         .chunk = 3,
+                         .total = 9,
+                         .sent_us = 100,
+                         .started_us = 200,
+                         .finished_us = 350,
+                         .cached = true,
+                         .priority = 4,
+                         .tenant = "t",
+                         .analyses = 7,
+                         .word_count = 123,
+                         .positive = 5,
+                         .negative = 8,
+                         .score = -3};
+    result.word_frequencies = {{"whale", 12}, {"sea", 1}, {"\"quoted\"", 2}};
+    if (compact) {
+        result.compact = true;
+        result.sorted_order = {{2, 40}, {0, 16}, {1, 0}};
+        result.name_edits = {{0, 8, 7}, {2, 0, 4}};
+        result.replacement = "ASSGRIM";
+    } else {
+        result.sorted_sentences = toViews(SENTENCES);
+        result.sentences_with_replaced_names = {SENTENCES[1], SENTENCES[0]};
+    }
+    return result;
+}
+
+void checkResult(const ResultMessage &decoded, const ResultMessage &expected, std::string_view what)
+{
+    check::that(decoded.id == expected.id && decoded.chunk == expected.chunk && decoded.total == expected.total,
+                fmt::format("{}: result ids", what));
+    check::that(decoded.sent_us == expected.sent_us && decoded.started_us == expected.started_us &&
+                    decoded.finished_us == expected.finished_us,
+                fmt::format("{}: result timestamps", what));
+    check::that(decoded.cached == expected.cached, fmt::format("{}: result cached flag", what));
+    check::that(decoded.priority == expected.priority && decoded.tenant == expected.tenant,
+                fmt::format("{}: result priority and tenant", what));
+    check::that(decoded.analyses == expected.analyses, fmt::format("{}: result analyses", what));
+    check::that(decoded.word_count == expected.word_count, fmt::format("{}: word count", what));
+    check::that(decoded.word_frequencies == expected.word_frequencies, fmt::format("{}: word frequencies", what));
+    check::that(decoded.positive == expected.positive && decoded.negative == expected.negative &&
+                    decoded.score == expected.score,
+                fmt::format("{}: sentiment", what));
+    check::that(decoded.compact == expected.compact, fmt::format("{}: compact flag", what));
+    check::that(decoded.sorted_sentences == expected.sorted_sentences, fmt::format("{}: sorted sentences", what));
+    check::that(decoded.sentences_with_replaced_names == expected.sentences_with_replaced_names,
+                fmt::format("{}: replaced names", what));
+
+    bool same_order = decoded.sorted_order.size() == expected.sorted_order.size();
+    for (size_t i = 0; same_order && i < expected.sorted_order.size(); ++i) {
+        same_order = decoded.sorted_order[i].index == expected.sorted_order[i].index &&
+                     decoded.sorted_order[i].length == expected.sorted_order[i].length;
+    }
+    check::that(same_order, fmt::format("{}: sorted order", what));
+    bool same_edits = decoded.name_edits.size() == expected.name_edits.size();
+    for (size_t i = 0; same_edits && i < expected.name_edits.size(); ++i) {
+        same_edits = decoded.name_edits[i].sentence == expected.name_edits[i].sentence &&
+                     decoded.name_edits[i].offset == expected.name_edits[i].offset &&
+                     decoded.name_edits[i].length == expected.name_edits[i].length;
+    }
+    check::that(same_edits, fmt::format("{}: name edits", what));
+    check::that(decoded.replacement == expected.replacement, fmt::format("{}: replacement", what));
+}
+
+void resultRoundTrip(Format format)
+{
+    auto name = formatName(format);
+    auto plain = makeResult(false);
+    auto compact = makeResult(true);
+    auto plain_body = encode(plain, format);
+    auto compact_body = encode(compact, format);
+    checkResult(decodeResult(plain_body, format), plain, fmt::format("{} plain", name));
+    checkResult(decodeResult(compact_body, format), compact, fmt::format("{} compact", name));
+
+    // Одиночный результат через decodeResults - пачка из одного
+    auto single = decodeResults(plain_body, format);
+    check::that(single.size() == 1, fmt::format("{}: single result as a batch", name));
+    if (single.size() == 1) {
+        checkResult(single[0], plain, fmt::format("{} single", name));
+    }
+
+    auto batch_body = encodeBatch({plain_body, compact_body, plain_body}, format);
+    auto batch = decodeResults(batch_body, format);
+    check::that(batch.size() == 3, fmt::format("{}: batch size", name));
+    if (batch.size() == 3) {
+        checkResult(batch[0], plain, fmt::format("{} batch[0]", name));
+        checkResult(batch[1], compact, fmt::format("{} batch[1]", name));
+        checkResult(batch[2], plain, fmt::format("{} batch[2]", name));
+    }
+}
+
+void feedbackRoundTrip(Format format)
+{
+    FeedbackMessage feedback{.id = 7, .chunk = 1ull << 33, .bytes = 65536, .processing_us = 1234567};
+    auto decoded = decodeFeedback(encode(feedback, format), format);
+    check::that(decoded.id == feedback.id && decoded.chunk == feedback.chunk && decoded.bytes == feedback.bytes &&
+                    decoded.processing_us == feedback.processing_us,
+                fmt::format("{}: feedback", formatName(format)));
+}
+
+void malformed()
+{
+    TaskMessage task{.id = 1, .sentences = toViews(SENTENCES)};
+    auto body = encode(task, Format::Binary);
+    for (size_t length : {size_t{0}, size_t{3}, body.size() / 2, body.size() - 1}) {
+        bool threw = false;
+        try {
+            decodeTask(std::string_view(body).substr(0, length), Format::Binary);
+        } catch (const std::exception &) {
+            threw = true;
+        }
+        check::that(threw, fmt::format("truncated task of {} bytes is rejected", length));
+    }
+    bool threw = false;
+    try {
+        decodeResult(body, Format::Binary);
+    } catch (const std::exception &) {
+        threw = true;
+    }
+    check::that(threw, "task body is not decoded as a result");
+}
+}
+
+int main()
+{
+    for (auto format : {Format::Binary, Format::Json}) {
+        taskRoundTrip(format);
+        resultRoundTrip(format);
+        feedbackRoundTrip(format);
+    }
+    malformed();
+    check::that(formatOf(contentType(Format::Binary)) == Format::Binary, "binary content type");
+    check::that(formatOf(contentType(Format::Json)) == Format::Json, "json content type");
+    check::that(formatOf("") == Format::Json, "missing content type means json");
+    return check::finish("wire_format");
+}